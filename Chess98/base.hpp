@@ -2,13 +2,18 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <cmath>
 #include <cstring>
 #include <ctime>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <random>
 #include <string>
+#include <sstream>
 #include <vector>
 #include <functional>
 #include <chrono>
@@ -17,15 +22,27 @@
 #include <fstream>
 #include <thread>
 #include <future>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #ifdef _WIN32
 #include <windows.h>
+#include <intrin.h>
 #elif __unix__
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #endif
 
 class Piece;
 class Move;
+class Bitboard90;
+class UndoInfo;
+class MoveList;
+class PieceList;
 class Result;
+class PvLine;
 class Trick;
 class TransItem;
 class Information;
@@ -44,6 +61,11 @@ const int INF = 1000000;
 const int BAN = INF - 2000;
 const int ILLEGAL_VAL = INF * 2;
 const int ENGINE_MAX_DEPTH = 64;
+const int MAX_MOVELIST_SIZE = 128;
+// 搜索线程数和置换表大小(MB)的上限, UCCI 设置和 bench 共用
+const int MAX_THREADS = 256;
+const int MAX_HASH_MB = 1 << 16;
+const int MAX_PIECELIST_SIZE = 16;
 const PIECE_INDEX EMPTY_INDEX = -1;
 const PIECEID EMPTY_PIECEID = 0;
 const PIECEID R_KING = 1;
@@ -61,6 +83,9 @@ const PIECEID B_ROOK = -5;
 const PIECEID B_CANNON = -6;
 const PIECEID B_PAWN = -7;
 const PIECEID OVERFLOW_PIECEID = 8;
+// 子力交换价值, 依次为 空、将、士、象、马、车、炮、兵
+// 静态交换评估与吃子着法排序共用这一张表, 大小顺序与 Board::getLeastAttacker 的查找顺序一致
+constexpr int SEE_VALUE[8] = {0, 10000, 200, 200, 400, 900, 450, 100};
 const TEAM EMPTY_TEAM = 0;
 const TEAM RED = 1;
 const TEAM BLACK = -1;
@@ -91,6 +116,7 @@ void writeFile(std::string filename, std::string content);
 PIECEID_MAP fenToPieceidmap(std::string fenCode);
 std::string pieceidmapToFen(PIECEID_MAP pieceidMap, TEAM team);
 TEAM fenToTeam(std::string fenCode);
+std::string moveToUcci(Move move);
 
 class Piece
 {
@@ -127,35 +153,209 @@ public:
     bool isLive = false;
 };
 
+// 紧凑着法, 只记录起点和终点坐标, 共4字节
+// 走子和吃子的棋子信息保存在棋盘的撤销栈中
 class Move
 {
 public:
     Move() = default;
-    Move(int x1, int y1, int x2, int y2, int val = 0, MOVE_TYPE moveType = NORMAL)
-        : x1(x1), y1(y1), x2(x2), y2(y2), val(val), moveType(moveType)
+    Move(int x1, int y1, int x2, int y2) : x1(int8_t(x1)), y1(int8_t(y1)), x2(int8_t(x2)), y2(int8_t(y2)) {}
+
+    constexpr bool operator==(const Move& move) const { return x1 == move.x1 && y1 == move.y1 && x2 == move.x2 && y2 == move.y2; }
+
+    constexpr bool operator!=(const Move& move) const { return !(*this == move); }
+
+    int id() const { return x1 == -1 ? -1 : x1 * 1000 + y1 * 100 + x2 * 10 + y2; }
+    int startpos() const { return x1 * 10 + y1; }
+    int endpos() const { return x2 * 10 + y2; }
+
+public:
+    int8_t x1 = -1;
+    int8_t y1 = -1;
+    int8_t x2 = -1;
+    int8_t y2 = -1;
+};
+
+// 整盘90格的位棋盘, 第 x * 10 + y 位表示 (x, y), 与 Move::startpos 的编号一致
+// 低64格放在 lo 中, 其余26格放在 hi 中
+class Bitboard90
+{
+public:
+    constexpr Bitboard90() = default;
+    constexpr Bitboard90(uint64 lo, uint64 hi) : lo(lo), hi(hi) {}
+    static Bitboard90 square(int sq) { return sq < 64 ? Bitboard90{1ULL << sq, 0} : Bitboard90{0, 1ULL << (sq - 64)}; }
+    // 把一个不超过10位的位串左移 n 位放入棋盘
+    static Bitboard90 shifted(uint64 bits, int n)
     {
-        this->id = x1 * 1000 + y1 * 100 + x2 * 10 + y2;
-        this->startpos = x1 * 10 + y1;
-        this->endpos = x2 * 10 + y2;
+        if (n == 0)
+        {
+            return Bitboard90{bits, 0};
+        }
+        if (n < 64)
+        {
+            return Bitboard90{bits << n, bits >> (64 - n)};
+        }
+        return Bitboard90{0, bits << (n - 64)};
     }
 
-    constexpr bool operator==(const Move& move) const { return this->id == move.id; }
+public:
+    uint64 lo = 0;
+    uint64 hi = 0;
+
+public:
+    bool test(int sq) const { return sq < 64 ? (lo >> sq) & 1 : (hi >> (sq - 64)) & 1; }
+    void set(int sq) { *this |= square(sq); }
+    void reset(int sq) { *this &= ~square(sq); }
+    bool empty() const { return (lo | hi) == 0; }
+    explicit operator bool() const { return !empty(); }
+    Bitboard90 operator&(const Bitboard90& b) const { return Bitboard90{lo & b.lo, hi & b.hi}; }
+    Bitboard90 operator|(const Bitboard90& b) const { return Bitboard90{lo | b.lo, hi | b.hi}; }
+    Bitboard90 operator^(const Bitboard90& b) const { return Bitboard90{lo ^ b.lo, hi ^ b.hi}; }
+    Bitboard90 operator~() const { return Bitboard90{~lo, ~hi & ((1ULL << 26) - 1)}; }
+    Bitboard90& operator&=(const Bitboard90& b) { return *this = *this & b; }
+    Bitboard90& operator|=(const Bitboard90& b) { return *this = *this | b; }
+    Bitboard90& operator^=(const Bitboard90& b) { return *this = *this ^ b; }
+    Bitboard90 operator<<(int n) const
+    {
+        if (n == 0)
+        {
+            return *this;
+        }
+        return Bitboard90{lo << n, (hi << n) | (lo >> (64 - n))};
+    }
+    // 取出并清除最低位的格子
+    int popLsb()
+    {
+        if (lo != 0)
+        {
+            const int sq = lsb(lo);
+            lo &= lo - 1;
+            return sq;
+        }
+        const int sq = 64 + lsb(hi);
+        hi &= hi - 1;
+        return sq;
+    }
+    int first() const { return lo != 0 ? lsb(lo) : 64 + lsb(hi); }
+
+protected:
+    static int lsb(uint64 bits)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward64(&index, bits);
+        return int(index);
+#else
+        return __builtin_ctzll(bits);
+#endif
+    }
+};
 
-    constexpr bool operator!=(const Move& move) const { return this->id != move.id; }
+// 撤销栈的一项, 记录一步棋走子、吃子的棋子信息
+class UndoInfo
+{
+public:
+    UndoInfo() = default;
+    UndoInfo(const Piece& attacker, const Piece& captured) : attacker(attacker), captured(captured) {}
 
 public:
-    int id = -1;
-    int startpos = -1;
-    int endpos = -1;
-    int x1 = -1;
-    int y1 = -1;
-    int x2 = -1;
-    int y2 = -1;
-    int val = 0;
-    MOVE_TYPE moveType = NORMAL;
-    bool isCheckingMove = false;
     Piece attacker{};
     Piece captured{};
+    bool isCheckingMove = false;
+    // 走完这步后走棋方被哪些棋子将军, 由 Board::getCheckers 第一次调用时计算
+    Bitboard90 checkers{};
+    TEAM checkersTeam = EMPTY_TEAM;
+};
+
+// 定长着法列表, 在栈上就地生成着法, 不产生堆分配
+// 象棋单个局面的着法数不超过120左右, 容量取128
+class MoveList
+{
+public:
+    MoveList() {} // 不清零分值数组
+    MoveList(const MoveList&) = delete;
+    MoveList& operator=(const MoveList&) = delete;
+
+protected:
+    Move moves[MAX_MOVELIST_SIZE];
+    int vals[MAX_MOVELIST_SIZE];
+    size_t count = 0;
+
+public:
+    Move* begin() { return moves; }
+    Move* end() { return moves + count; }
+    const Move* begin() const { return moves; }
+    const Move* end() const { return moves + count; }
+    Move& operator[](size_t i) { return moves[i]; }
+    const Move& operator[](size_t i) const { return moves[i]; }
+    Move& back() { return moves[count - 1]; }
+    int& val(size_t i) { return vals[i]; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    void clear() { count = 0; }
+    void resize(size_t size)
+    {
+        assert(size <= count);
+        count = size;
+    }
+    void emplace_back(const Move& move)
+    {
+        assert(count < MAX_MOVELIST_SIZE);
+        moves[count++] = move;
+    }
+    void sortByVal()
+    {
+        // 着法数不多, 插入排序, 按分值从大到小且保持原有次序
+        for (size_t i = 1; i < count; i++)
+        {
+            const Move move = moves[i];
+            const int vl = vals[i];
+            size_t j = i;
+            for (; j > 0 && vals[j - 1] < vl; j--)
+            {
+                moves[j] = moves[j - 1];
+                vals[j] = vals[j - 1];
+            }
+            moves[j] = move;
+            vals[j] = vl;
+        }
+    }
+    void selectBest(size_t from)
+    {
+        // 部分选择排序, 只把剩余着法中分值最大的换到 from 处
+        size_t best = from;
+        for (size_t i = from + 1; i < count; i++)
+        {
+            if (vals[i] > vals[best])
+            {
+                best = i;
+            }
+        }
+        std::swap(moves[from], moves[best]);
+        std::swap(vals[from], vals[best]);
+    }
+};
+
+// 同种棋子的索引列表, 定长数组存放, 复制棋盘时不产生堆分配
+class PieceList
+{
+public:
+    PieceList() = default;
+
+protected:
+    PIECE_INDEX indexes[MAX_PIECELIST_SIZE]{};
+    size_t count = 0;
+
+public:
+    const PIECE_INDEX* begin() const { return indexes; }
+    const PIECE_INDEX* end() const { return indexes + count; }
+    PIECE_INDEX operator[](size_t i) const { return indexes[i]; }
+    size_t size() const { return count; }
+    void emplace_back(PIECE_INDEX index)
+    {
+        assert(count < MAX_PIECELIST_SIZE);
+        indexes[count++] = index;
+    }
 };
 
 class Result
@@ -169,6 +369,18 @@ public:
     int vl = 0;
 };
 
+class PvLine
+{
+public:
+    PvLine() = default;
+    PvLine(Move move, int vl, MOVES moves) : move(move), vl(vl), moves(std::move(moves)) {}
+
+public:
+    Move move{};
+    int vl = 0;
+    MOVES moves{};
+};
+
 class Trick
 {
 public:
@@ -186,16 +398,9 @@ public:
     TransItem() = default;
 
 public:
-    int32 hashLock = 0;
-    int32 vlExact = -INF;
-    int32 vlBeta = -INF;
-    int32 vlAlpha = -INF;
-    int32 exactDepth = 0;
-    int32 betaDepth = 0;
-    int32 alphaDepth = 0;
-    Move exactMove{};
-    Move betaMove{};
-    Move alphaMove{};
+    // 16字节的置换表项, key与data异或后存储, 读出时再异或校验, 被撕裂的读写会自然失配
+    std::atomic<uint64> keyXorData{0};
+    std::atomic<uint64> data{0};
 };
 
 class Information
@@ -211,6 +416,11 @@ public:
         durationMs.fill(0);
         vlSearched.fill(0);
         moveSearched.fill(Move{});
+        seldepthSearched.fill(0);
+        nodesSearched.fill(0);
+        hashfullSearched.fill(0);
+        pvSearched.fill(MOVES{});
+        linesSearched.fill(std::vector<PvLine>{});
     }
 
 public:
@@ -220,6 +430,11 @@ public:
     std::array<int, ENGINE_MAX_DEPTH> durationMs{};
     std::array<int, ENGINE_MAX_DEPTH> vlSearched{};
     std::array<Move, ENGINE_MAX_DEPTH> moveSearched{};
+    std::array<int, ENGINE_MAX_DEPTH> seldepthSearched{};
+    std::array<uint64, ENGINE_MAX_DEPTH> nodesSearched{};
+    std::array<int, ENGINE_MAX_DEPTH> hashfullSearched{};
+    std::array<MOVES, ENGINE_MAX_DEPTH> pvSearched{};
+    std::array<std::vector<PvLine>, ENGINE_MAX_DEPTH> linesSearched{};
 
 protected:
     int printedDepth = 0;
@@ -233,13 +448,19 @@ public:
         print();
     }
 
-    void setInfo(int vl, Move move, int duration)
+    void setInfo(int vl, Move move, int duration, int seldepth = 0, uint64 nodes = 0, int hashfull = 0, const MOVES& pv = {},
+                 const std::vector<PvLine>& lines = {})
     {
         if (depth < ENGINE_MAX_DEPTH)
         {
             this->vlSearched[depth] = vl;
             this->moveSearched[depth] = move;
             this->durationMs[depth] = duration;
+            this->seldepthSearched[depth] = seldepth;
+            this->nodesSearched[depth] = nodes;
+            this->hashfullSearched[depth] = hashfull;
+            this->pvSearched[depth] = pv;
+            this->linesSearched[depth] = lines;
         }
         depth++;
         print();
@@ -268,13 +489,53 @@ public:
         }
         while (printedDepth < depth)
         {
-            std::cout << "info depth " << (printedDepth + 1);
-            std::cout << " score cp " << vlSearched[printedDepth];
-            std::cout << " time " << durationMs[printedDepth];
+            // 多主要变例时每条变例输出一行
+            const std::vector<PvLine>& lines = linesSearched[printedDepth];
+            if (lines.size() > 1)
+            {
+                for (size_t i = 0; i < lines.size(); i++)
+                {
+                    printLine(int(i + 1), lines[i].vl, lines[i].moves);
+                }
+            }
+            else if (!pvSearched[printedDepth].empty() || moveSearched[printedDepth].id() == -1)
+            {
+                printLine(0, vlSearched[printedDepth], pvSearched[printedDepth]);
+            }
+            else
+            {
+                printLine(0, vlSearched[printedDepth], MOVES{moveSearched[printedDepth]});
+            }
             printedDepth++;
-            std::cout << std::endl;
         }
     }
+
+protected:
+    void printLine(int multipv, int vl, const MOVES& pv) const
+    {
+        const int duration = durationMs[printedDepth];
+        const uint64 nodes = nodesSearched[printedDepth];
+        std::cout << "info depth " << (printedDepth + 1);
+        std::cout << " seldepth " << std::max(seldepthSearched[printedDepth], printedDepth + 1);
+        if (multipv > 0)
+        {
+            std::cout << " multipv " << multipv;
+        }
+        std::cout << " score cp " << vl;
+        std::cout << " nodes " << nodes;
+        std::cout << " nps " << nodes * 1000 / uint64(std::max(duration, 1));
+        std::cout << " hashfull " << hashfullSearched[printedDepth];
+        std::cout << " time " << duration;
+        if (!pv.empty())
+        {
+            std::cout << " pv";
+            for (const Move& move : pv)
+            {
+                std::cout << " " << moveToUcci(move);
+            }
+        }
+        std::cout << std::endl;
+    }
 };
 
 void wait(int ms)
@@ -287,6 +548,29 @@ void command(std::string str)
     int res = system(str.c_str());
 }
 
+// 解析整数参数, 不是合法整数时返回 false, 界面或命令行传来的错误参数不能让引擎退出
+bool parseInt(const std::string& text, int64_t& value)
+{
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    errno = 0;
+    const long long result = std::strtoll(begin, &end, 10);
+    if (end == begin || errno == ERANGE)
+    {
+        return false;
+    }
+    // 数字后面只允许有空白
+    for (; *end != '\0'; end++)
+    {
+        if (!std::isspace(static_cast<unsigned char>(*end)))
+        {
+            return false;
+        }
+    }
+    value = int64_t(result);
+    return true;
+}
+
 void readFile(std::string filename, std::string& content)
 {
     std::ifstream file(filename, std::ios::in | std::ios::binary);
@@ -385,6 +669,16 @@ std::string pieceidmapToFen(PIECEID_MAP pieceidMap, TEAM team)
     return result;
 }
 
+std::string moveToUcci(Move move)
+{
+    std::string ret = "";
+    ret += char('a' + move.x1);
+    ret += char('0' + move.y1);
+    ret += char('a' + move.x2);
+    ret += char('0' + move.y2);
+    return ret;
+}
+
 TEAM fenToTeam(std::string fen)
 {
     return fen.find("w") != std::string::npos ? RED : BLACK;
@@ -0,0 +1,74 @@
+﻿#pragma once
+#include "search.hpp"
+
+// 固定深度的搜索速度测试
+// 对内置局面逐个搜索, 输出总节点数, 用时与 NPS
+// 单线程时节点总数是确定的, 可作为检查搜索行为是否改变的签名
+class Bench
+{
+public:
+    static const std::vector<std::string>& positions()
+    {
+        static const std::vector<std::string> FENS = {
+            "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1",
+            "2bak4/3Ra4/3n5/p8/2b2PP1p/2NR5/P1r1N3P/1r2n4/4A4/2BK1A3 w - - 0 1",
+            "5R3/C3k4/5a3/p1P4cp/2r3b2/3N5/P2n4P/B8/4A4/4KAB2 w - - 0 1",
+            "1rbakabr1/9/n5n1c/p1p1p3p/6p2/9/P1cRP1P1P/1CN1B1NC1/5R3/3AKAB2 w - - 0 1",
+            "1rbak4/4a4/4bc3/p3p3p/2p3P2/1C2P4/P1PN2nnP/2N6/1R3r3/1RBAKABC1 w - - 0 1",
+            "3rkab2/2C1a4/4b1R2/p3p3p/3n3N1/9/P3P3P/4B4/9/1rCcKABR1 w - - 0 1",
+            "2bak4/4a4/4b4/4R3N/pr4Pn1/2B6/1Cc1P4/1RN2n3/4K2r1/3A1A3 w - - 0 1",
+            "2ba1a3/2Nk5/9/2P1P4/3N2p2/9/8P/4Bn3/3RK2c1/1r1A1AB2 w - - 0 1",
+            "2b1k4/3Pa4/4b1C2/p1C1pR2p/5c3/5r3/P3P3P/2N2A2B/4AKn2/9 w - - 0 1",
+        };
+        return FENS;
+    }
+
+public:
+    static uint64 run(int depth = 7, int threads = 1, int hashMb = 16);
+};
+
+uint64 Bench::run(int depth, int threads, int hashMb)
+{
+    depth = std::max<int>(1, std::min<int>(depth, ENGINE_MAX_DEPTH - 1));
+    threads = std::max<int>(1, std::min<int>(threads, MAX_THREADS));
+    hashMb = std::max<int>(1, std::min<int>(hashMb, MAX_HASH_MB));
+
+    // 每个局面都从空的置换表开始, 保证结果不受前一个局面影响
+    std::shared_ptr<Tt> tt = std::make_shared<Tt>();
+    tt->resize(hashMb);
+
+    uint64 totalNodes = 0;
+    uint64 totalQNodes = 0;
+    uint64 totalTtHits = 0;
+    uint64 totalTtStores = 0;
+    int64_t totalMs = 0;
+    for (const std::string& fen : Bench::positions())
+    {
+        tt->reset();
+        Search search{fenToPieceidmap(fen), fenToTeam(fen)};
+        search.tt = tt;
+        search.useBook = false;
+        search.threads = threads;
+
+        const auto start = std::chrono::steady_clock::now();
+        const Result result = search.searchMain(depth, TimeLimits{});
+        const int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        totalNodes += search.stats.totalNodes();
+        totalQNodes += search.stats.qnodes.load();
+        totalTtHits += search.stats.ttHits.load();
+        totalTtStores += search.stats.ttStores.load();
+        totalMs += ms;
+        std::cout << "bench nodes " << search.stats.totalNodes() << " time " << ms << " score " << result.vl << std::endl;
+    }
+
+    const uint64 nps = totalNodes * 1000 / uint64(std::max<int64_t>(totalMs, 1));
+    std::cout << "===========================" << std::endl;
+    std::cout << "depth " << depth << " threads " << threads << " hash " << hashMb << std::endl;
+    std::cout << "total time (ms) : " << totalMs << std::endl;
+    std::cout << "nodes searched  : " << totalNodes << std::endl;
+    std::cout << "qsearch nodes   : " << totalQNodes << std::endl;
+    std::cout << "tt hits/stores  : " << totalTtHits << " / " << totalTtStores << std::endl;
+    std::cout << "nodes/second    : " << nps << std::endl;
+    return totalNodes;
+}
@@ -2,6 +2,7 @@
 #include "base.hpp"
 
 class Bitboard;
+class AttackTables;
 using UINT32 = unsigned;
 using BITARRAY_X = std::array<UINT32, 9>;
 using BITARRAY_Y = std::array<UINT32, 10>;
@@ -9,113 +10,212 @@ using REGION_ROOK = std::array<int, 2>;
 using REGION_CANNON = std::array<int, 4>;
 using TYPE_ROOK_CACHE = std::array<std::array<REGION_ROOK, 10>, 1024>;
 using TYPE_CANNON_CACHE = std::array<std::array<REGION_CANNON, 10>, 1024>;
+using TYPE_LINE_CACHE = std::array<std::array<UINT32, 10>, 1024>;
 
-class Bitboard
+// 所有棋盘共用的走法表, 首次使用时生成一次
+// 士、象、将、兵的表按队伍区分, 下标 0 为红方, 1 为黑方
+class AttackTables
 {
 public:
-    Bitboard(PIECEID_MAP pieceidMap);
+    static const AttackTables& get()
+    {
+        static const AttackTables tables{};
+        return tables;
+    }
 
 protected:
+    AttackTables();
+
+public:
     TYPE_ROOK_CACHE rookCache{};
     TYPE_CANNON_CACHE cannonCache{};
-    BITARRAY_X xBitBoard{0, 0, 0, 0, 0, 0, 0, 0, 0};
-    BITARRAY_Y yBitBoard{0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    TYPE_LINE_CACHE rookLine{};
+    TYPE_LINE_CACHE cannonLine{};
+    std::array<Bitboard90, 512> rankSpread{};
+    // 四个斜向相邻格, 即马腿(从目标格看)和象眼, -1 表示在棋盘外
+    std::array<std::array<int, 4>, 90> diagonal{};
+    // 马从 sq 出发, 第 i 个方向的马腿没有被堵住时能到达的格子
+    std::array<std::array<Bitboard90, 4>, 90> knightTargets{};
+    std::array<std::array<int, 4>, 90> knightLegs{};
+    // 马腿为 sq 的第 i 个斜向相邻格时, 能攻击到 sq 的马所在的格子
+    std::array<std::array<Bitboard90, 4>, 90> knightSources{};
+    std::array<std::array<Bitboard90, 90>, 2> kingSteps{};
+    std::array<std::array<Bitboard90, 90>, 2> guardSteps{};
+    std::array<std::array<std::array<Bitboard90, 4>, 90>, 2> bishopSteps{};
+    std::array<std::array<Bitboard90, 90>, 2> pawnAttacks{};
+    std::array<std::array<Bitboard90, 90>, 2> pawnSources{};
 
 public:
-    REGION_ROOK getRookRegion(UINT32 bitline, int index, int endpos);
-    REGION_CANNON getCannonRegion(UINT32 bitline, int index, int endpos);
-    UINT32 getBitlineX(int x) const { return this->xBitBoard[x]; }
-    UINT32 getBitlineY(int y) const { return this->yBitBoard[y]; }
-    void doMove(int x1, int y1, int x2, int y2);
-    void undoMove(int x1, int y1, int x2, int y2, bool eaten);
+    static int teamIndex(TEAM team) { return team == RED ? 0 : 1; }
 
 protected:
-    UINT32 getBit(UINT32 bitline, int index) const { return (bitline >> index) & 1; }
-    void setBit(int x, int y);
-    void deleteBit(int x, int y);
-    REGION_ROOK generateRookRegion(UINT32 bitline, int index) const;
-    REGION_CANNON generateCannonRegion(UINT32 bitline, int index) const;
+    static bool onBoard(int x, int y) { return x >= 0 && x <= 8 && y >= 0 && y <= 9; }
+    static bool inPalace(int index, int x, int y) { return onBoard(x, y) && x >= 3 && x <= 5 && (index == 0 ? y <= 2 : y >= 7); }
+    static bool ownSide(int index, int y) { return index == 0 ? y <= 4 : y >= 5; }
+    static UINT32 getBit(UINT32 bitline, int index) { return (bitline >> index) & 1; }
+    static REGION_ROOK generateRookRegion(UINT32 bitline, int index);
+    static REGION_CANNON generateCannonRegion(UINT32 bitline, int index);
 };
 
-Bitboard::Bitboard(PIECEID_MAP pieceidMap)
+AttackTables::AttackTables()
 {
-    // 初始化棋盘
-    for (int x = 0; x < 9; x++)
+    // 车、炮的着法范围缓存, 以及由此得到的攻击位串
+    for (UINT32 bitline = 1; bitline < 1024; bitline++)
     {
-        for (int y = 0; y < 10; y++)
+        for (int index = 0; index <= 9; index++)
         {
-            if (pieceidMap[x][y] != EMPTY_PIECEID) this->setBit(x, y);
+            if (getBit(bitline, index) == 1)
+            {
+                const REGION_ROOK rook = generateRookRegion(bitline, index);
+                const REGION_CANNON cannon = generateCannonRegion(bitline, index);
+                this->rookCache[bitline][index] = rook;
+                this->cannonCache[bitline][index] = cannon;
+                UINT32 rookBits = 0;
+                for (int pos = rook[0]; pos <= rook[1]; pos++)
+                {
+                    rookBits |= pos == index ? 0 : (1U << pos);
+                }
+                this->rookLine[bitline][index] = rookBits;
+                UINT32 cannonBits = 0;
+                if (cannon[0] != cannon[1])
+                {
+                    cannonBits |= 1U << cannon[0];
+                }
+                if (cannon[3] != cannon[2])
+                {
+                    cannonBits |= 1U << cannon[3];
+                }
+                this->cannonLine[bitline][index] = cannonBits;
+            }
         }
     }
-    // 初始化车、炮的着法缓存
-    for (UINT32 bitline = 1; bitline <= pow(2, 10); bitline++)
+    for (UINT32 bits = 0; bits < 512; bits++)
     {
-        for (int index = 0; index <= 9; index++)
+        for (int x = 0; x < 9; x++)
         {
-            if (this->getBit(bitline, index) == 1)
+            if (getBit(bits, x) == 1)
             {
-                this->rookCache[bitline][index] = this->generateRookRegion(bitline, index);
-                this->cannonCache[bitline][index] = this->generateCannonRegion(bitline, index);
+                this->rankSpread[bits].set(x * 10);
             }
         }
     }
-}
-
-REGION_ROOK Bitboard::getRookRegion(UINT32 bitline, int index, int endpos)
-{
-    REGION_ROOK result = this->rookCache[bitline][index];
-    if (endpos == 8 && result[1] == 9)
-    {
-        result[1] = 8;
-    }
-    return result;
-}
 
-REGION_CANNON Bitboard::getCannonRegion(UINT32 bitline, int index, int endpos)
-{
-    REGION_CANNON result = this->cannonCache[bitline][index];
-    if (endpos == 8 && result[3] == 9)
+    const int DX[4] = {1, -1, 1, -1};
+    const int DY[4] = {1, 1, -1, -1};
+    for (int x = 0; x < 9; x++)
     {
-        result[2] = result[3] = 8;
+        for (int y = 0; y < 10; y++)
+        {
+            const int sq = x * 10 + y;
+            for (int i = 0; i < 4; i++)
+            {
+                const int dx = DX[i];
+                const int dy = DY[i];
+                this->diagonal[sq][i] = onBoard(x + dx, y + dy) ? (x + dx) * 10 + y + dy : -1;
+                // 从目标格看, 马腿是斜向相邻格, 马在马腿再向外横走或竖走一格的位置
+                if (onBoard(x + 2 * dx, y + dy))
+                {
+                    this->knightSources[sq][i].set((x + 2 * dx) * 10 + y + dy);
+                }
+                if (onBoard(x + dx, y + 2 * dy))
+                {
+                    this->knightSources[sq][i].set((x + dx) * 10 + y + 2 * dy);
+                }
+            }
+            // 从马所在格看, 马腿是上下左右四个相邻格
+            const int LX[4] = {1, -1, 0, 0};
+            const int LY[4] = {0, 0, 1, -1};
+            for (int i = 0; i < 4; i++)
+            {
+                const int lx = x + LX[i];
+                const int ly = y + LY[i];
+                this->knightLegs[sq][i] = onBoard(lx, ly) ? lx * 10 + ly : -1;
+                if (!onBoard(lx, ly))
+                {
+                    continue;
+                }
+                const int tx = lx + LX[i];
+                const int ty = ly + LY[i];
+                const int sideX = LY[i];
+                const int sideY = LX[i];
+                if (onBoard(tx + sideX, ty + sideY))
+                {
+                    this->knightTargets[sq][i].set((tx + sideX) * 10 + ty + sideY);
+                }
+                if (onBoard(tx - sideX, ty - sideY))
+                {
+                    this->knightTargets[sq][i].set((tx - sideX) * 10 + ty - sideY);
+                }
+            }
+            for (int index = 0; index < 2; index++)
+            {
+                const int forward = index == 0 ? 1 : -1;
+                if (inPalace(index, x, y))
+                {
+                    for (int i = 0; i < 4; i++)
+                    {
+                        if (inPalace(index, x + LX[i], y + LY[i]))
+                        {
+                            this->kingSteps[index][sq].set((x + LX[i]) * 10 + y + LY[i]);
+                        }
+                        if (inPalace(index, x + DX[i], y + DY[i]))
+                        {
+                            this->guardSteps[index][sq].set((x + DX[i]) * 10 + y + DY[i]);
+                        }
+                    }
+                }
+                if (ownSide(index, y))
+                {
+                    for (int i = 0; i < 4; i++)
+                    {
+                        const int tx = x + 2 * DX[i];
+                        const int ty = y + 2 * DY[i];
+                        if (onBoard(tx, ty) && ownSide(index, ty))
+                        {
+                            this->bishopSteps[index][sq][i].set(tx * 10 + ty);
+                        }
+                    }
+                }
+                // 兵向前一格, 过河后可以左右各一格
+                if (onBoard(x, y + forward))
+                {
+                    this->pawnAttacks[index][sq].set(x * 10 + y + forward);
+                }
+                if (!ownSide(index, y))
+                {
+                    if (onBoard(x - 1, y))
+                    {
+                        this->pawnAttacks[index][sq].set((x - 1) * 10 + y);
+                    }
+                    if (onBoard(x + 1, y))
+                    {
+                        this->pawnAttacks[index][sq].set((x + 1) * 10 + y);
+                    }
+                }
+            }
+        }
     }
-    return result;
-}
-
-void Bitboard::doMove(int x1, int y1, int x2, int y2)
-{
-    bool ret = bool(this->getBit(x2, y2));
-    this->deleteBit(x1, y1);
-    this->setBit(x2, y2);
-}
-
-void Bitboard::undoMove(int x1, int y1, int x2, int y2, bool eaten)
-{
-    this->setBit(x1, y1);
-    if (!eaten)
+    // 兵的来源表由走法表反推
+    for (int index = 0; index < 2; index++)
     {
-        this->deleteBit(x2, y2);
+        for (int sq = 0; sq < 90; sq++)
+        {
+            Bitboard90 targets = this->pawnAttacks[index][sq];
+            while (!targets.empty())
+            {
+                this->pawnSources[index][targets.popLsb()].set(sq);
+            }
+        }
     }
 }
 
-void Bitboard::setBit(int x, int y)
-{
-    this->xBitBoard[x] |= (1 << y);
-    this->yBitBoard[y] |= (1 << x);
-}
-
-void Bitboard::deleteBit(int x, int y)
-{
-    this->xBitBoard[x] &= ~(1 << y);
-    this->yBitBoard[y] &= ~(1 << x);
-}
-
-REGION_ROOK Bitboard::generateRookRegion(UINT32 bitline, int index) const
+REGION_ROOK AttackTables::generateRookRegion(UINT32 bitline, int index)
 {
     int beg = 0;
     int end = 9;
     for (int pos = index - 1; pos >= 0; pos--)
     {
-        if (this->getBit(bitline, pos) != 0)
+        if (getBit(bitline, pos) != 0)
         {
             beg = pos;
             break;
@@ -123,7 +223,7 @@ REGION_ROOK Bitboard::generateRookRegion(UINT32 bitline, int index) const
     }
     for (int pos = index + 1; pos <= 9; pos++)
     {
-        if (this->getBit(bitline, pos) != 0)
+        if (getBit(bitline, pos) != 0)
         {
             end = pos;
             break;
@@ -133,7 +233,7 @@ REGION_ROOK Bitboard::generateRookRegion(UINT32 bitline, int index) const
     return REGION_ROOK{beg, end};
 }
 
-REGION_CANNON Bitboard::generateCannonRegion(UINT32 bitline, int index) const
+REGION_CANNON AttackTables::generateCannonRegion(UINT32 bitline, int index)
 {
     int eaten1 = 0;
     int beg = 0;
@@ -141,13 +241,13 @@ REGION_CANNON Bitboard::generateCannonRegion(UINT32 bitline, int index) const
     int eaten2 = 9;
     for (int pos = index - 1; pos >= 0; pos--)
     {
-        if (this->getBit(bitline, pos) != 0)
+        if (getBit(bitline, pos) != 0)
         {
             beg = pos + 1;
             eaten1 = pos + 1;
             for (int pos2 = pos - 1; pos2 >= 0; pos2--)
             {
-                if (this->getBit(bitline, pos2) != 0)
+                if (getBit(bitline, pos2) != 0)
                 {
                     eaten1 = pos2;
                     break;
@@ -158,13 +258,13 @@ REGION_CANNON Bitboard::generateCannonRegion(UINT32 bitline, int index) const
     }
     for (int pos = index + 1; pos <= 9; pos++)
     {
-        if (this->getBit(bitline, pos) != 0)
+        if (getBit(bitline, pos) != 0)
         {
             end = pos - 1;
             eaten2 = pos - 1;
             for (int pos2 = pos + 1; pos2 <= 9; pos2++)
             {
-                if (this->getBit(bitline, pos2) != 0)
+                if (getBit(bitline, pos2) != 0)
                 {
                     eaten2 = pos2;
                     break;
@@ -176,3 +276,179 @@ REGION_CANNON Bitboard::generateCannonRegion(UINT32 bitline, int index) const
 
     return REGION_CANNON{eaten1, beg, end, eaten2};
 }
+
+class Bitboard
+{
+public:
+    Bitboard(PIECEID_MAP pieceidMap);
+
+protected:
+    const AttackTables& tables = AttackTables::get();
+    BITARRAY_X xBitBoard{0, 0, 0, 0, 0, 0, 0, 0, 0};
+    BITARRAY_Y yBitBoard{0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    // 按棋子种类区分的整盘位棋盘, 下标为 pieceid + 7
+    std::array<Bitboard90, 15> pieceBits{};
+    std::array<Bitboard90, 2> teamBits{};
+    Bitboard90 occupied{};
+
+public:
+    REGION_ROOK getRookRegion(UINT32 bitline, int index, int endpos) const;
+    REGION_CANNON getCannonRegion(UINT32 bitline, int index, int endpos) const;
+    UINT32 getBitlineX(int x) const { return this->xBitBoard[x]; }
+    UINT32 getBitlineY(int y) const { return this->yBitBoard[y]; }
+    void doMove(int x1, int y1, int x2, int y2, PIECEID attacker, PIECEID captured);
+    void undoMove(int x1, int y1, int x2, int y2, PIECEID attacker, PIECEID captured);
+
+public:
+    const AttackTables& getTables() const { return this->tables; }
+    Bitboard90 getPieces(PIECEID pieceid) const { return this->pieceBits[pieceid + 7]; }
+    Bitboard90 getTeam(TEAM team) const { return this->teamBits[AttackTables::teamIndex(team)]; }
+    Bitboard90 getOccupied() const { return this->occupied; }
+    // 车从 (x, y) 能走到的格子, 包括两端的第一个棋子
+    Bitboard90 rookAttacks(int x, int y) const
+    {
+        const UINT32 fileBits = this->tables.rookLine[this->xBitBoard[x]][y];
+        const UINT32 rankBits = this->tables.rookLine[this->yBitBoard[y]][x] & 0x1FF;
+        return Bitboard90::shifted(fileBits, x * 10) | (this->tables.rankSpread[rankBits] << y);
+    }
+    // 炮从 (x, y) 隔一个炮架能吃到的格子
+    Bitboard90 cannonCaptures(int x, int y) const
+    {
+        const UINT32 fileBits = this->tables.cannonLine[this->xBitBoard[x]][y];
+        const UINT32 rankBits = this->tables.cannonLine[this->yBitBoard[y]][x] & 0x1FF;
+        return Bitboard90::shifted(fileBits, x * 10) | (this->tables.rankSpread[rankBits] << y);
+    }
+    Bitboard90 knightAttacks(int sq) const
+    {
+        Bitboard90 result{};
+        for (int i = 0; i < 4; i++)
+        {
+            const int leg = this->tables.knightLegs[sq][i];
+            if (leg != -1 && !this->occupied.test(leg))
+            {
+                result |= this->tables.knightTargets[sq][i];
+            }
+        }
+        return result;
+    }
+    // 能攻击到 sq 的马可能在的格子
+    Bitboard90 knightSources(int sq) const
+    {
+        Bitboard90 result{};
+        for (int i = 0; i < 4; i++)
+        {
+            const int leg = this->tables.diagonal[sq][i];
+            if (leg != -1 && !this->occupied.test(leg))
+            {
+                result |= this->tables.knightSources[sq][i];
+            }
+        }
+        return result;
+    }
+    Bitboard90 bishopAttacks(TEAM team, int sq) const
+    {
+        Bitboard90 result{};
+        const int index = AttackTables::teamIndex(team);
+        for (int i = 0; i < 4; i++)
+        {
+            const int eye = this->tables.diagonal[sq][i];
+            if (eye != -1 && !this->occupied.test(eye))
+            {
+                result |= this->tables.bishopSteps[index][sq][i];
+            }
+        }
+        return result;
+    }
+
+protected:
+    void setBit(int x, int y);
+    void deleteBit(int x, int y);
+};
+
+Bitboard::Bitboard(PIECEID_MAP pieceidMap)
+{
+    // 初始化棋盘
+    for (int x = 0; x < 9; x++)
+    {
+        for (int y = 0; y < 10; y++)
+        {
+            const PIECEID pieceid = pieceidMap[x][y];
+            if (pieceid != EMPTY_PIECEID)
+            {
+                this->setBit(x, y);
+                this->pieceBits[pieceid + 7].set(x * 10 + y);
+                this->teamBits[pieceid > 0 ? 0 : 1].set(x * 10 + y);
+            }
+        }
+    }
+    this->occupied = this->teamBits[0] | this->teamBits[1];
+}
+
+REGION_ROOK Bitboard::getRookRegion(UINT32 bitline, int index, int endpos) const
+{
+    REGION_ROOK result = this->tables.rookCache[bitline][index];
+    if (endpos == 8 && result[1] == 9)
+    {
+        result[1] = 8;
+    }
+    return result;
+}
+
+REGION_CANNON Bitboard::getCannonRegion(UINT32 bitline, int index, int endpos) const
+{
+    REGION_CANNON result = this->tables.cannonCache[bitline][index];
+    if (endpos == 8 && result[3] == 9)
+    {
+        result[2] = result[3] = 8;
+    }
+    return result;
+}
+
+void Bitboard::doMove(int x1, int y1, int x2, int y2, PIECEID attacker, PIECEID captured)
+{
+    const int sq1 = x1 * 10 + y1;
+    const int sq2 = x2 * 10 + y2;
+    const Bitboard90 fromTo = Bitboard90::square(sq1) | Bitboard90::square(sq2);
+    this->deleteBit(x1, y1);
+    this->setBit(x2, y2);
+    this->pieceBits[attacker + 7] ^= fromTo;
+    this->teamBits[attacker > 0 ? 0 : 1] ^= fromTo;
+    if (captured != EMPTY_PIECEID)
+    {
+        this->pieceBits[captured + 7].reset(sq2);
+        this->teamBits[captured > 0 ? 0 : 1].reset(sq2);
+    }
+    this->occupied = this->teamBits[0] | this->teamBits[1];
+}
+
+void Bitboard::undoMove(int x1, int y1, int x2, int y2, PIECEID attacker, PIECEID captured)
+{
+    const int sq1 = x1 * 10 + y1;
+    const int sq2 = x2 * 10 + y2;
+    const Bitboard90 fromTo = Bitboard90::square(sq1) | Bitboard90::square(sq2);
+    this->setBit(x1, y1);
+    this->pieceBits[attacker + 7] ^= fromTo;
+    this->teamBits[attacker > 0 ? 0 : 1] ^= fromTo;
+    if (captured != EMPTY_PIECEID)
+    {
+        this->pieceBits[captured + 7].set(sq2);
+        this->teamBits[captured > 0 ? 0 : 1].set(sq2);
+    }
+    else
+    {
+        this->deleteBit(x2, y2);
+    }
+    this->occupied = this->teamBits[0] | this->teamBits[1];
+}
+
+void Bitboard::setBit(int x, int y)
+{
+    this->xBitBoard[x] |= (1 << y);
+    this->yBitBoard[y] |= (1 << x);
+}
+
+void Bitboard::deleteBit(int x, int y)
+{
+    this->xBitBoard[x] &= ~(1 << y);
+    this->yBitBoard[y] &= ~(1 << x);
+}
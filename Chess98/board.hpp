@@ -8,30 +8,33 @@ class Board
 public:
     Board() = default;
     Board(PIECEID_MAP pieceidMap, TEAM initTeam);
+    Board(const Board& board);
+    Board& operator=(const Board& board);
 
 public:
     int distance = 0;
     int vlRed = 0;
     int vlBlack = 0;
-    int32 hashKey = 0;
-    int32 hashLock = 0;
-    std::vector<int32> hashKeyList{};
-    std::vector<int32> hashLockList{};
+    uint64 hashKey = 0;
+    std::vector<uint64> hashKeyList{};
+    std::shared_ptr<const EvaluateContext> evalContext = EvaluateContext::empty();
 
 public:
     PIECEID_MAP pieceidMap{};
     MOVES historyMoves{};
+    std::vector<UndoInfo> undoStack{};
     TEAM team{};
     std::unique_ptr<Bitboard> bitboard{};
     PIECES pieces{};
     std::vector<PIECE_INDEX> redPieces{};
     std::vector<PIECE_INDEX> blackPieces{};
     std::array<std::array<PIECE_INDEX, 10>, 9> pieceIndexMap{};
-    std::map<PIECEID, std::vector<PIECE_INDEX>> pieceTypes{};
+    // 按 pieceid + 7 索引的同种棋子列表
+    std::array<PieceList, 15> pieceTypes{};
 
 public:
     bool isKingLive(TEAM team) const { return team == RED ? getPieceByType(R_KING).isLive : getPieceByType(B_KING).isLive; }
-    int evaluate() const { return team == RED ? vlRed - vlBlack + vlAdvanced : vlBlack - vlRed + vlAdvanced; };
+    int evaluate() const { return team == RED ? vlRed - vlBlack + evalContext->vlAdvanced : vlBlack - vlRed + evalContext->vlAdvanced; };
     void doNullMove() { team = -team; }
     void undoNullMove() { team = -team; }
     bool nullOkay() const { return team == RED ? vlRed : vlBlack > 10000 + 600; }
@@ -52,6 +55,9 @@ public:
     bool hasCrossedRiver(int x, int y) const;
     bool isInPalace(int x, int y) const;
     bool inCheck(TEAM judgeTeam) const;
+    Bitboard90 getCheckersOf(TEAM judgeTeam) const;
+    Bitboard90 getCheckers();
+    bool isChecked() { return !this->getCheckers().empty(); }
     bool hasProtector(int x, int y) const;
 
 public:
@@ -64,6 +70,9 @@ public:
     void vlAttackCalculator(int& vlRedAttack, int& vlBlackAttack) const;
     void initHashInfo();
     bool isValidMoveInSituation(Move move);
+    bool isLegalMove(Move move, bool checked);
+    Move getLeastAttacker(int x, int y, TEAM attackTeam) const;
+    int see(Move move);
 
 protected:
     void changeSide() { this->team = -this->team; }
@@ -72,12 +81,21 @@ protected:
     void historyMovePush(const Move& move, const Piece& attacker, const Piece& captured)
     {
         this->historyMoves.emplace_back(move);
-        this->historyMoves.back().attacker = attacker;
-        this->historyMoves.back().captured = captured;
+        this->undoStack.emplace_back(attacker, captured);
+    }
+    void historyMovePop()
+    {
+        this->historyMoves.pop_back();
+        this->undoStack.pop_back();
+    }
+    void bitboardDoMove(int x1, int y1, int x2, int y2, PIECEID attacker, PIECEID captured)
+    {
+        this->bitboard->doMove(x1, y1, x2, y2, attacker, captured);
+    }
+    void bitboardUndoMove(int x1, int y1, int x2, int y2, PIECEID attacker, PIECEID captured)
+    {
+        this->bitboard->undoMove(x1, y1, x2, y2, attacker, captured);
     }
-    void historyMovePop() { this->historyMoves.pop_back(); }
-    void bitboardDoMove(int x1, int y1, int x2, int y2) { this->bitboard->doMove(x1, y1, x2, y2); }
-    void bitboardUndoMove(int x1, int y1, int x2, int y2, const bool& eaten) { this->bitboard->undoMove(x1, y1, x2, y2, eaten); }
     void piecePositionDoMove(int x1, int y1, int x2, int y2)
     {
         const Piece& attacker = this->piecePosition(x1, y1);
@@ -93,7 +111,7 @@ protected:
             this->pieces[captured.pieceIndex].isLive = false;
         }
     }
-    void piecePositionUndoMove(int x1, int y1, int x2, int y2, const Move& back)
+    void piecePositionUndoMove(int x1, int y1, int x2, int y2, const UndoInfo& back)
     {
         const Piece& attacker = back.attacker;
         const Piece& captured = back.captured;
@@ -113,22 +131,22 @@ protected:
         // 更新评估分
         if (attacker.team == RED)
         {
-            int valNewPos = pieceWeights[attacker.pieceid][x2][y2];
-            int valOldPos = pieceWeights[attacker.pieceid][x1][y1];
+            int valNewPos = this->evalContext->weight(attacker.pieceid, x2, y2);
+            int valOldPos = this->evalContext->weight(attacker.pieceid, x1, y1);
             this->vlRed += (valNewPos - valOldPos);
             if (captured.pieceid != EMPTY_PIECEID)
             {
-                this->vlBlack -= pieceWeights[captured.pieceid][x2][size_t(9) - y2];
+                this->vlBlack -= this->evalContext->weight(captured.pieceid, x2, 9 - y2);
             }
         }
         else
         {
-            int valNewPos = pieceWeights[attacker.pieceid][x2][size_t(9) - y2];
-            int valOldPos = pieceWeights[attacker.pieceid][x1][size_t(9) - y1];
+            int valNewPos = this->evalContext->weight(attacker.pieceid, x2, 9 - y2);
+            int valOldPos = this->evalContext->weight(attacker.pieceid, x1, 9 - y1);
             this->vlBlack += (valNewPos - valOldPos);
             if (captured.pieceid != EMPTY_PIECEID)
             {
-                this->vlRed -= pieceWeights[captured.pieceid][x2][y2];
+                this->vlRed -= this->evalContext->weight(captured.pieceid, x2, y2);
             }
         }
     }
@@ -137,22 +155,22 @@ protected:
         // 更新评估分
         if (attacker.team == RED)
         {
-            int valPos1 = pieceWeights[attacker.pieceid][x1][y1];
-            int valPos2 = pieceWeights[attacker.pieceid][x2][y2];
+            int valPos1 = this->evalContext->weight(attacker.pieceid, x1, y1);
+            int valPos2 = this->evalContext->weight(attacker.pieceid, x2, y2);
             this->vlRed -= (valPos2 - valPos1);
             if (captured.pieceid != EMPTY_PIECEID)
             {
-                this->vlBlack += pieceWeights[captured.pieceid][x2][size_t(9) - y2];
+                this->vlBlack += this->evalContext->weight(captured.pieceid, x2, 9 - y2);
             }
         }
         else
         {
-            int valPos1 = pieceWeights[attacker.pieceid][x1][size_t(9) - y1];
-            int valPos2 = pieceWeights[attacker.pieceid][x2][size_t(9) - y2];
+            int valPos1 = this->evalContext->weight(attacker.pieceid, x1, 9 - y1);
+            int valPos2 = this->evalContext->weight(attacker.pieceid, x2, 9 - y2);
             this->vlBlack -= (valPos2 - valPos1);
             if (captured.pieceid != EMPTY_PIECEID)
             {
-                this->vlRed += pieceWeights[captured.pieceid][x2][y2];
+                this->vlRed += this->evalContext->weight(captured.pieceid, x2, y2);
             }
         }
     }
@@ -160,26 +178,18 @@ protected:
     {
         // 记录旧哈希值
         this->hashKeyList.emplace_back(this->hashKey);
-        this->hashLockList.emplace_back(this->hashLock);
         // 更新哈希值
-        this->hashKey ^= HASHKEYS[attacker.pieceid][x1][y1];
-        this->hashKey ^= HASHKEYS[attacker.pieceid][x2][y2];
-        this->hashLock ^= HASHLOCKS[attacker.pieceid][x1][y1];
-        this->hashLock ^= HASHLOCKS[attacker.pieceid][x2][y2];
+        this->hashKey ^= zobristKey(attacker.pieceid, x1, y1) ^ zobristKey(attacker.pieceid, x2, y2);
         if (captured.pieceid != EMPTY_PIECEID)
         {
-            this->hashKey ^= HASHKEYS[captured.pieceid][x1][y1];
-            this->hashLock ^= HASHLOCKS[captured.pieceid][x2][y2];
+            this->hashKey ^= zobristKey(captured.pieceid, x2, y2);
         }
-        this->hashKey ^= PLAYER_KEY;
-        this->hashLock ^= PLAYER_LOCK;
+        this->hashKey ^= PLAYER_ZOBRIST;
     }
     void undoHashUpdate()
     {
         this->hashKey = this->hashKeyList.back();
-        this->hashLock = this->hashLockList.back();
         this->hashKeyList.pop_back();
-        this->hashLockList.pop_back();
     }
 };
 
@@ -188,10 +198,6 @@ Board::Board(PIECEID_MAP pieceidMap, TEAM team)
     this->pieceidMap = pieceidMap;
     this->team = team;
     this->bitboard = std::make_unique<Bitboard>(pieceidMap);
-    for (const PIECEID& id : ALL_PIECEIDS)
-    {
-        this->pieceTypes[id] = std::vector<PIECE_INDEX>{};
-    }
     for (int x = 0; x < 9; x++)
     {
         for (int y = 0; y < 10; y++)
@@ -205,7 +211,7 @@ Board::Board(PIECEID_MAP pieceidMap, TEAM team)
 
                 this->pieces.emplace_back(piece);
                 this->pieceIndexMap[x][y] = index;
-                this->pieceTypes[pieceid].emplace_back(this->pieces.back().pieceIndex);
+                this->pieceTypes[size_t(pieceid + 7)].emplace_back(this->pieces.back().pieceIndex);
                 if (pieceid > 0)
                 {
                     this->redPieces.emplace_back(index);
@@ -225,6 +231,39 @@ Board::Board(PIECEID_MAP pieceidMap, TEAM team)
     this->initHashInfo();
 }
 
+Board::Board(const Board& board)
+    : distance(board.distance), vlRed(board.vlRed), vlBlack(board.vlBlack), hashKey(board.hashKey),
+      hashKeyList(board.hashKeyList), evalContext(board.evalContext), pieceidMap(board.pieceidMap), historyMoves(board.historyMoves),
+      undoStack(board.undoStack), team(board.team), bitboard(std::make_unique<Bitboard>(*board.bitboard)), pieces(board.pieces), redPieces(board.redPieces),
+      blackPieces(board.blackPieces), pieceIndexMap(board.pieceIndexMap), pieceTypes(board.pieceTypes)
+{
+    // 位棋盘由unique_ptr持有, 需要深拷贝, 供多线程搜索时各线程持有独立的棋盘
+}
+
+Board& Board::operator=(const Board& board)
+{
+    if (this != &board)
+    {
+        this->distance = board.distance;
+        this->vlRed = board.vlRed;
+        this->vlBlack = board.vlBlack;
+        this->hashKey = board.hashKey;
+        this->hashKeyList = board.hashKeyList;
+        this->evalContext = board.evalContext;
+        this->pieceidMap = board.pieceidMap;
+        this->historyMoves = board.historyMoves;
+        this->undoStack = board.undoStack;
+        this->team = board.team;
+        this->bitboard = std::make_unique<Bitboard>(*board.bitboard);
+        this->pieces = board.pieces;
+        this->redPieces = board.redPieces;
+        this->blackPieces = board.blackPieces;
+        this->pieceIndexMap = board.pieceIndexMap;
+        this->pieceTypes = board.pieceTypes;
+    }
+    return *this;
+}
+
 PIECEID Board::pieceidOn(int x, int y) const
 {
     if (x >= 0 && x <= 8 && y >= 0 && y <= 9)
@@ -303,13 +342,13 @@ PIECES Board::getPiecesByTeam(TEAM team) const
 
 Piece Board::getPieceByType(PIECEID pieceid) const
 {
-    return this->pieceIndex(this->pieceTypes.at(pieceid)[0]);
+    return this->pieceIndex(this->pieceTypes[size_t(pieceid + 7)][0]);
 }
 
 PIECES Board::getPiecesPyType(PIECEID pieceid) const
 {
     PIECES result{};
-    for (PIECE_INDEX pieceindex : this->pieceTypes.at(pieceid))
+    for (PIECE_INDEX pieceindex : this->pieceTypes[size_t(pieceid + 7)])
     {
         const Piece& piece = this->pieceIndex(pieceindex);
         if (piece.isLive)
@@ -334,8 +373,8 @@ bool Board::isRepeated() const
         // 判断是否出现重复局面, 没有则直接false
         // 试想如下重复局面：（格式：plyX: x1y1x2y2）
         // ply1: 0001, ply2: 0908, ply3: 0100, ply4: 0809, ply5: 0001
-        const bool isRepeat = (ply1 == ply5 && ply1.startpos == ply3.endpos && ply1.endpos == ply3.startpos &&
-                               ply2.startpos == ply4.endpos && ply2.endpos == ply4.startpos);
+        const bool isRepeat = (ply1 == ply5 && ply1.startpos() == ply3.endpos() && ply1.endpos() == ply3.startpos() &&
+                               ply2.startpos() == ply4.endpos() && ply2.endpos() == ply4.startpos());
         if (!isRepeat)
         {
             return false;
@@ -345,17 +384,18 @@ bool Board::isRepeated() const
         // 由于性能原因, isCheckingMove是被延迟设置的, ply1可能还没有被设成checkingMove
         // 但是若判定了循环局面, ply1必然等于ply5
         // 若ply5和ply3都是将军着法, 且出现循环局面, 则直接判定违规
-        if (ply5.isCheckingMove == true && ply3.isCheckingMove == true)
+        const std::vector<UndoInfo>& undos = this->undoStack;
+        if (undos[size - 5].isCheckingMove == true && undos[size - 3].isCheckingMove == true)
         {
             return true;
         }
         // 长捉情况比较特殊
         // 只有车、马、炮能作为长捉的发起者
         // 发起者不断捉同一个子, 判负
-        if (abs(ply1.attacker.pieceid) == R_ROOK || abs(ply1.attacker.pieceid) == R_KNIGHT || abs(ply1.attacker.pieceid) == R_CANNON)
+        const Piece& attacker = undos[size - 1].attacker;
+        if (abs(attacker.pieceid) == R_ROOK || abs(attacker.pieceid) == R_KNIGHT || abs(attacker.pieceid) == R_CANNON)
         {
-            const Piece& attacker = ply1.attacker;
-            const Piece& captured = ply2.attacker;
+            const Piece& captured = undos[size - 2].attacker;
             // 车
             if (abs(attacker.pieceid) == R_ROOK)
             {
@@ -455,113 +495,28 @@ bool Board::isInPalace(int x, int y) const
 bool Board::inCheck(TEAM judgeTeam) const
 {
     const Piece& king = judgeTeam == RED ? this->getPieceByType(R_KING) : this->getPieceByType(B_KING);
-    int x = king.x;
-    int y = king.y;
-    const TEAM& team = king.team;
+    const int x = king.x;
+    const int y = king.y;
+    const int sq = x * 10 + y;
+    const TEAM enemy = -king.team;
+    const Bitboard& bb = *this->bitboard;
 
-    // 兵
-    const PIECEID ENEMY_PAWN = R_PAWN * -team;
-    if (this->pieceidOn(x + 1, y) == ENEMY_PAWN)
-    {
-        return true;
-    }
-    if (this->pieceidOn(x - 1, y) == ENEMY_PAWN)
+    // 兵、马
+    if (bb.getTables().pawnSources[AttackTables::teamIndex(enemy)][sq] & bb.getPieces(R_PAWN * enemy))
     {
         return true;
     }
-    if (this->pieceidOn(x, (team == RED ? y - 1 : y + 1)) == ENEMY_PAWN)
+    if (bb.knightSources(sq) & bb.getPieces(R_KNIGHT * enemy))
     {
         return true;
     }
 
-    // 马
-    const PIECEID ENEMY_KNIGHT = R_KNIGHT * -team;
-    if (this->pieceidOn(x + 1, y + 1) == EMPTY_PIECEID)
-    {
-        if (this->pieceidOn(x + 2, y + 1) == ENEMY_KNIGHT)
-        {
-            return true;
-        }
-        if (this->pieceidOn(x + 1, y + 2) == ENEMY_KNIGHT)
-        {
-            return true;
-        }
-    }
-    if (this->pieceidOn(x - 1, y + 1) == EMPTY_PIECEID)
-    {
-        if (this->pieceidOn(x - 2, y + 1) == ENEMY_KNIGHT)
-        {
-            return true;
-        }
-        if (this->pieceidOn(x - 1, y + 2) == ENEMY_KNIGHT)
-        {
-            return true;
-        }
-    }
-    if (this->pieceidOn(x + 1, y - 1) == EMPTY_PIECEID)
-    {
-        if (this->pieceidOn(x + 2, y - 1) == ENEMY_KNIGHT)
-        {
-            return true;
-        }
-        if (this->pieceidOn(x + 1, y - 2) == ENEMY_KNIGHT)
-        {
-            return true;
-        }
-    }
-    if (this->pieceidOn(x - 1, y - 1) == EMPTY_PIECEID)
-    {
-        if (this->pieceidOn(x - 2, y - 1) == ENEMY_KNIGHT)
-        {
-            return true;
-        }
-        if (this->pieceidOn(x - 1, y - 2) == ENEMY_KNIGHT)
-        {
-            return true;
-        }
-    }
-
-    // 将、车、炮
-    const PIECEID ENEMY_ROOK = R_ROOK * -team;
-    const PIECEID ENEMY_CANNON = R_CANNON * -team;
-    const PIECEID ENEMY_KING = R_KING * -team;
-
-    UINT32 bitlineY = this->getBitLineY(y);
-    REGION_CANNON regionY = this->bitboard->getCannonRegion(bitlineY, x, 8);
-    if (this->pieceidOn(regionY[1] - 1, y) == ENEMY_ROOK)
+    // 车、炮, 以及将帅照面
+    if (bb.rookAttacks(x, y) & (bb.getPieces(R_ROOK * enemy) | bb.getPieces(R_KING * enemy)))
     {
         return true;
     }
-    if (this->pieceidOn(regionY[2] + 1, y) == ENEMY_ROOK)
-    {
-        return true;
-    }
-    if (this->pieceidOn(regionY[0], y) == ENEMY_CANNON)
-    {
-        return true;
-    }
-    if (this->pieceidOn(regionY[3], y) == ENEMY_CANNON)
-    {
-        return true;
-    }
-
-    UINT32 bitlineX = this->getBitLineX(x);
-    REGION_CANNON regionX = this->bitboard->getCannonRegion(bitlineX, y, 9);
-    const PIECEID& p1 = this->pieceidOn(x, regionX[1] - 1);
-    if (p1 == ENEMY_ROOK || p1 == ENEMY_KING)
-    {
-        return true;
-    }
-    const PIECEID& p2 = this->pieceidOn(x, regionX[2] + 1);
-    if (p2 == ENEMY_ROOK || p2 == ENEMY_KING)
-    {
-        return true;
-    }
-    if (this->pieceidOn(x, regionX[0]) == ENEMY_CANNON)
-    {
-        return true;
-    }
-    if (this->pieceidOn(x, regionX[3]) == ENEMY_CANNON)
+    if (bb.cannonCaptures(x, y) & bb.getPieces(R_CANNON * enemy))
     {
         return true;
     }
@@ -569,185 +524,47 @@ bool Board::inCheck(TEAM judgeTeam) const
     return false;
 }
 
-bool Board::hasProtector(int x, int y) const
+Bitboard90 Board::getCheckersOf(TEAM judgeTeam) const
 {
-    const Piece& piece = this->piecePosition(x, y);
-    const TEAM& team = piece.team;
+    const Piece& king = judgeTeam == RED ? this->getPieceByType(R_KING) : this->getPieceByType(B_KING);
+    const int x = king.x;
+    const int y = king.y;
+    const int sq = x * 10 + y;
+    const TEAM enemy = -king.team;
+    const Bitboard& bb = *this->bitboard;
 
-    // 兵
-    const PIECEID MY_PAWN = R_PAWN * team;
-    if (this->hasCrossedRiver(x + 1, y) && this->pieceidOn(x + 1, y) == MY_PAWN)
-    {
-        return true;
-    }
-    if (this->hasCrossedRiver(x - 1, y) && this->pieceidOn(x - 1, y) == MY_PAWN)
-    {
-        return true;
-    }
-    if (this->pieceidOn(x, team == RED ? y - 1 : y + 1) == MY_PAWN)
-    {
-        return true;
-    }
+    Bitboard90 checkers = bb.getTables().pawnSources[AttackTables::teamIndex(enemy)][sq] & bb.getPieces(R_PAWN * enemy);
+    checkers |= bb.knightSources(sq) & bb.getPieces(R_KNIGHT * enemy);
+    checkers |= bb.rookAttacks(x, y) & (bb.getPieces(R_ROOK * enemy) | bb.getPieces(R_KING * enemy));
+    checkers |= bb.cannonCaptures(x, y) & bb.getPieces(R_CANNON * enemy);
+    return checkers;
+}
 
-    // 马
-    const PIECEID MY_KNIGHT = R_KNIGHT * team;
-    if (this->pieceidOn(x + 1, y + 1) == EMPTY_PIECEID)
-    {
-        if (this->pieceidOn(x + 2, y + 1) == MY_KNIGHT)
-        {
-            return true;
-        }
-        if (this->pieceidOn(x + 1, y + 2) == MY_KNIGHT)
-        {
-            return true;
-        }
-    }
-    if (this->pieceidOn(x - 1, y + 1) == EMPTY_PIECEID)
-    {
-        if (this->pieceidOn(x - 2, y + 1) == MY_KNIGHT)
-        {
-            return true;
-        }
-        if (this->pieceidOn(x - 1, y + 2) == MY_KNIGHT)
-        {
-            return true;
-        }
-    }
-    if (this->pieceidOn(x + 1, y - 1) == EMPTY_PIECEID)
-    {
-        if (this->pieceidOn(x + 2, y - 1) == MY_KNIGHT)
-        {
-            return true;
-        }
-        if (this->pieceidOn(x + 1, y - 2) == MY_KNIGHT)
-        {
-            return true;
-        }
-    }
-    if (this->pieceidOn(x - 1, y - 1) == EMPTY_PIECEID)
+Bitboard90 Board::getCheckers()
+{
+    // 走棋方被哪些棋子将军, 结果缓存在撤销栈顶, 同一局面只计算一次
+    // 空着之后走棋方变了, 缓存按走棋方区分
+    if (this->undoStack.empty())
     {
-        if (this->pieceidOn(x - 2, y - 1) == MY_KNIGHT)
-        {
-            return true;
-        }
-        if (this->pieceidOn(x - 1, y - 2) == MY_KNIGHT)
-        {
-            return true;
-        }
+        return this->getCheckersOf(this->team);
     }
-
-    // 士、象、将
-    const PIECEID MY_BISHOP = R_BISHOP * team;
-    const PIECEID MY_GUARD = R_GUARD * team;
-    const PIECEID MY_KING = R_KING * team;
-    if (hasCrossedRiver(x, y) == false)
+    UndoInfo& top = this->undoStack.back();
+    if (top.checkersTeam != this->team)
     {
-        if (this->pieceidOn(x + 1, y + 1) == EMPTY_PIECEID)
-        {
-            if (this->pieceidOn(x + 2, y + 2) == MY_BISHOP)
-            {
-                return true;
-            }
-        }
-        if (this->pieceidOn(x - 1, y + 1) == EMPTY_PIECEID)
-        {
-            if (this->pieceidOn(x - 2, y + 2) == MY_BISHOP)
-            {
-                return true;
-            }
-        }
-        if (this->pieceidOn(x + 1, y - 1) == EMPTY_PIECEID)
-        {
-            if (this->pieceidOn(x + 2, y - 2) == MY_BISHOP)
-            {
-                return true;
-            }
-        }
-        if (this->pieceidOn(x - 1, y - 1) == EMPTY_PIECEID)
+        top.checkers = this->getCheckersOf(this->team);
+        top.checkersTeam = this->team;
+        if (top.attacker.team == -this->team)
         {
-            if (this->pieceidOn(x - 2, y - 2) == MY_BISHOP)
-            {
-                return true;
-            }
-        }
-        if (isInPalace(x, y))
-        {
-            if (this->pieceidOn(x + 1, y) == MY_GUARD)
-            {
-                return true;
-            }
-            if (this->pieceidOn(x - 1, y) == MY_GUARD)
-            {
-                return true;
-            }
-            if (this->pieceidOn(x, y + 1) == MY_GUARD)
-            {
-                return true;
-            }
-            if (this->pieceidOn(x, y - 1) == MY_GUARD)
-            {
-                return true;
-            }
-            if (this->pieceidOn(x + 1, y) == MY_KING)
-            {
-                return true;
-            }
-            if (this->pieceidOn(x - 1, y) == MY_KING)
-            {
-                return true;
-            }
-            if (this->pieceidOn(x, y + 1) == MY_KING)
-            {
-                return true;
-            }
-            if (this->pieceidOn(x, y - 1) == MY_KING)
-            {
-                return true;
-            }
+            top.isCheckingMove = !top.checkers.empty();
         }
     }
+    return top.checkers;
+}
 
-    // 车、炮
-    const PIECEID MY_ROOK = R_ROOK * team;
-    const PIECEID MY_CANNON = R_CANNON * team;
-
-    UINT32 bitlineY = this->getBitLineY(y);
-    REGION_CANNON regionY = this->bitboard->getCannonRegion(bitlineY, x, 8);
-    if (this->pieceidOn(regionY[1] - 1, y) == MY_ROOK)
-    {
-        return true;
-    }
-    if (this->pieceidOn(regionY[2] + 1, y) == MY_ROOK)
-    {
-        return true;
-    }
-    if (this->pieceidOn(regionY[0], y) == MY_CANNON)
-    {
-        return true;
-    }
-    if (this->pieceidOn(regionY[3], y) == MY_CANNON)
-    {
-        return true;
-    }
-    UINT32 bitlineX = this->getBitLineX(x);
-    REGION_CANNON regionX = this->bitboard->getCannonRegion(bitlineX, y, 9);
-    if (this->pieceidOn(x, regionX[1] - 1) == MY_ROOK)
-    {
-        return true;
-    }
-    if (this->pieceidOn(x, regionX[2] + 1) == MY_ROOK)
-    {
-        return true;
-    }
-    if (this->pieceidOn(x, regionX[0]) == MY_CANNON)
-    {
-        return true;
-    }
-    if (this->pieceidOn(x, regionX[3]) == MY_CANNON)
-    {
-        return true;
-    }
-    return false;
+bool Board::hasProtector(int x, int y) const
+{
+    // 有本方棋子能吃到这个位置, 即为有保护
+    return this->getLeastAttacker(x, y, this->teamOn(x, y)).id() != -1;
 }
 
 void Board::doMove(Move move)
@@ -761,7 +578,7 @@ void Board::doMove(Move move)
     changeSide();
     addDistane();
     historyMovePush(move, attacker, captured);
-    bitboardDoMove(x1, y1, x2, y2);
+    bitboardDoMove(x1, y1, x2, y2, attacker.pieceid, captured.pieceid);
     piecePositionDoMove(x1, y1, x2, y2);
     doEvaluationUpdate(attacker, captured, x1, y1, x2, y2);
     doHashUpdate(attacker, captured, x1, y1, x2, y2);
@@ -769,26 +586,27 @@ void Board::doMove(Move move)
 
 void Board::undoMove()
 {
-    const Move& back = this->historyMoves.back();
+    const Move back = this->historyMoves.back();
+    const UndoInfo undo = this->undoStack.back();
     int x1 = back.x1;
     int x2 = back.x2;
     int y1 = back.y1;
     int y2 = back.y2;
-    const Piece& attacker = back.attacker;
-    const Piece& captured = back.captured;
+    const Piece& attacker = undo.attacker;
+    const Piece& captured = undo.captured;
     reduceDistance();
     changeSide();
     historyMovePop();
-    bitboardUndoMove(x1, y1, x2, y2, captured.pieceid != 0);
-    piecePositionUndoMove(x1, y1, x2, y2, back);
+    bitboardUndoMove(x1, y1, x2, y2, attacker.pieceid, captured.pieceid);
+    piecePositionUndoMove(x1, y1, x2, y2, undo);
     undoEvaluationUpdate(attacker, captured, x1, y1, x2, y2);
     undoHashUpdate();
 }
 
 void Board::doMoveSimple(Move move)
 {
-    const int &x1 = move.x1, &x2 = move.x2;
-    const int &y1 = move.y1, &y2 = move.y2;
+    const int x1 = move.x1, x2 = move.x2;
+    const int y1 = move.y1, y2 = move.y2;
     const Piece& attacker = this->piecePosition(x1, y1);
     const Piece& captured = this->piecePosition(x2, y2);
     this->pieceidMap[x2][y2] = this->pieceidMap[x1][y1];
@@ -798,10 +616,9 @@ void Board::doMoveSimple(Move move)
     this->pieces[attacker.pieceIndex].x = x2;
     this->pieces[attacker.pieceIndex].y = y2;
     this->team = -this->team;
-    this->historyMoves.emplace_back(Move{x1, y1, x2, y2});
-    this->historyMoves.back().attacker = attacker;
-    this->historyMoves.back().captured = captured;
-    this->bitboard->doMove(x1, y1, x2, y2);
+    this->historyMoves.emplace_back(move);
+    this->undoStack.emplace_back(attacker, captured);
+    this->bitboard->doMove(x1, y1, x2, y2, attacker.pieceid, captured.pieceid);
     if (captured.pieceIndex != -1)
     {
         this->pieces[captured.pieceIndex].isLive = false;
@@ -810,11 +627,12 @@ void Board::doMoveSimple(Move move)
 
 void Board::undoMoveSimple()
 {
-    const Move& back = this->historyMoves.back();
-    const int &x1 = back.x1, &x2 = back.x2;
-    const int &y1 = back.y1, &y2 = back.y2;
-    const Piece& attacker = back.attacker;
-    const Piece& captured = back.captured;
+    const Move back = this->historyMoves.back();
+    const UndoInfo undo = this->undoStack.back();
+    const int x1 = back.x1, x2 = back.x2;
+    const int y1 = back.y1, y2 = back.y2;
+    const Piece& attacker = undo.attacker;
+    const Piece& captured = undo.captured;
     this->pieceidMap[x1][y1] = this->pieceidMap[x2][y2];
     this->pieceidMap[x2][y2] = captured.pieceid;
     this->pieceIndexMap[x1][y1] = this->pieceIndexMap[x2][y2];
@@ -823,7 +641,8 @@ void Board::undoMoveSimple()
     this->pieces[attacker.pieceIndex].y = y1;
     this->team = -this->team;
     this->historyMoves.pop_back();
-    this->bitboard->undoMove(x1, y1, x2, y2, captured.pieceid != 0);
+    this->undoStack.pop_back();
+    this->bitboard->undoMove(x1, y1, x2, y2, attacker.pieceid, captured.pieceid);
     if (captured.pieceIndex != -1)
     {
         this->pieces[captured.pieceIndex].isLive = true;
@@ -839,9 +658,8 @@ void Board::initEvaluate()
     this->calculateVlOpen(vlOpen);
     this->vlAttackCalculator(vlRedAttack, vlBlackAttack);
 
-    pieceWeights = getBasicEvaluateWeights(vlOpen, vlRedAttack, vlBlackAttack);
-    vlAdvanced = (TOTAL_ADVANCED_VALUE * vlOpen + TOTAL_ADVANCED_VALUE / 2) / TOTAL_MIDGAME_VALUE;
-    vlPawn = (vlOpen * OPEN_PAWN_VAL + (TOTAL_MIDGAME_VALUE - vlOpen) * END_PAWN_VAL) / TOTAL_MIDGAME_VALUE;
+    // 生成新的上下文, 不修改其他棋盘正在使用的权重
+    this->evalContext = std::make_shared<const EvaluateContext>(vlOpen, vlRedAttack, vlBlackAttack);
 
     // 调整不受威胁方少掉的士象分
     this->vlRed = ADVISOR_BISHOP_ATTACKLESS_VALUE * (TOTAL_ATTACK_VALUE - vlBlackAttack) / TOTAL_ATTACK_VALUE;
@@ -855,11 +673,11 @@ void Board::initEvaluate()
             PIECEID pid = this->pieceidMap[x][y];
             if (pid > 0)
             {
-                this->vlRed += pieceWeights[pid][x][y];
+                this->vlRed += this->evalContext->weight(pid, x, y);
             }
             else if (pid < 0)
             {
-                this->vlBlack += pieceWeights[pid][x][size_t(9) - y];
+                this->vlBlack += this->evalContext->weight(pid, x, 9 - y);
             }
         }
     }
@@ -991,7 +809,6 @@ void Board::vlAttackCalculator(int& vlRedAttack, int& vlBlackAttack) const
 void Board::initHashInfo()
 {
     this->hashKey = 0;
-    this->hashLock = 0;
     for (int x = 0; x < 9; x++)
     {
         for (int y = 0; y < 10; y++)
@@ -999,78 +816,129 @@ void Board::initHashInfo()
             const PIECEID& pid = this->pieceidMap[x][y];
             if (pid != EMPTY_PIECEID)
             {
-                this->hashKey ^= HASHKEYS[pid][x][y];
-                this->hashLock ^= HASHLOCKS[pid][x][y];
+                this->hashKey ^= zobristKey(pid, x, y);
             }
         }
     }
     if (this->team == BLACK)
     {
-        this->hashKey ^= PLAYER_KEY;
-        this->hashLock ^= PLAYER_LOCK;
+        this->hashKey ^= PLAYER_ZOBRIST;
     }
 }
 
 bool Board::isValidMoveInSituation(Move move)
 {
-    PIECEID attacker = this->pieceidOn(move.x1, move.y1);
-    if (attacker == 0) // 若攻击者不存在, 则一定是不合理着法
-        return false;
-    if (attacker != move.attacker.pieceid) // 若攻击者不一致, 则一定是不合理着法
+    // 杀手着法、置换表着法可能来自别的局面, 需要完整校验
+    if (move.id() == -1)
         return false;
-    if (move.attacker.team != this->team) // 若攻击者的队伍和当前队伍不一致, 则一定是不合理着法
+    const int x1 = move.x1, y1 = move.y1;
+    const int x2 = move.x2, y2 = move.y2;
+    if (this->teamOn(x1, y1) != this->team) // 起点必须是本方棋子
         return false;
-    PIECEID captured = this->pieceidOn(move.x2, move.y2);
-    if (captured != 0 && this->teamOn(move.x2, move.y2) == this->teamOn(move.x1, move.y1)) // 吃子着法, 若吃子者和被吃者同队伍, 则一定不合理
+    const TEAM capturedTeam = this->teamOn(x2, y2);
+    if (capturedTeam == this->team || capturedTeam == OVERFLOW_TEAM) // 终点不能是本方棋子或棋盘外
         return false;
+    const int dx = x2 - x1;
+    const int dy = y2 - y1;
 
     // 分类
-    if (abs(attacker) == R_ROOK)
+    const PIECEID attacker = abs(this->pieceidOn(x1, y1));
+    if (attacker == R_KING || attacker == R_GUARD)
     {
-        if (move.x1 != move.x2 && move.y1 != move.y2) // 车走法, 若横纵坐标都不相同, 则一定不合理
-            return false;
-        // 生成车的着法范围, 看是否有障碍物
-        UINT32 bitlineX = this->getBitLineX(move.x1);
-        REGION_ROOK regionX = this->bitboard->getRookRegion(bitlineX, move.y1, 9);
-        if (move.y2 < regionX[0] || move.y2 > regionX[1]) return false;
-        // 横向
-        UINT32 bitlineY = this->getBitLineY(move.y1);
-        REGION_ROOK regionY = this->bitboard->getRookRegion(bitlineY, move.x1, 8);
-        if (move.x2 < regionY[0] || move.x2 > regionY[1]) return false;
+        // 将走一步直线, 士走一步斜线, 都不能出九宫
+        const bool step = attacker == R_KING ? (abs(dx) + abs(dy) == 1) : (abs(dx) == 1 && abs(dy) == 1);
+        const bool inPalace = x2 >= 3 && x2 <= 5 && (this->team == RED ? y2 <= 2 : y2 >= 7);
+        if (!step || !inPalace) return false;
+    }
+    else if (attacker == R_BISHOP)
+    {
+        // 象走田字, 不能过河, 象眼不能有棋子
+        if (abs(dx) != 2 || abs(dy) != 2) return false;
+        if (this->team == RED ? y2 > 4 : y2 < 5) return false;
+        if (this->pieceidOn(x1 + dx / 2, y1 + dy / 2) != 0) return false;
     }
-    else if (abs(attacker) == R_KNIGHT)
+    else if (attacker == R_KNIGHT)
     {
-        if (move.x1 - 1 == move.x2 || move.x1 + 1 == move.x2) // 向哪一边走就判断那一边有没有障碍物
+        // 马走日字, 向哪一边走就判断那一边有没有障碍物
+        if (abs(dx) == 1 && abs(dy) == 2)
         {
-            if (move.y1 - 2 == move.y2 && this->pieceidOn(move.x1, move.y1 - 1) != 0) // 若有障碍物则不合理
-                return false;
-            if (move.y1 + 2 == move.y2 && this->pieceidOn(move.x1, move.y1 + 1) != 0) return false;
+            if (this->pieceidOn(x1, y1 + dy / 2) != 0) return false;
+        }
+        else if (abs(dx) == 2 && abs(dy) == 1)
+        {
+            if (this->pieceidOn(x1 + dx / 2, y1) != 0) return false;
         }
         else
         {
-            if (move.x1 - 2 == move.x2 && this->pieceidOn(move.x1 - 1, move.y1) != 0) // 若有障碍物则不合理
-                return false;
-            if (move.x1 + 2 == move.x2 && this->pieceidOn(move.x1 + 1, move.y1) != 0) return false;
+            return false;
         }
-        return true;
     }
-    else if (abs(attacker) == R_BISHOP)
+    else if (attacker == R_ROOK)
     {
-        // 象走法, 不能有障碍物
-        if (this->pieceidOn((move.x1 + move.x2) / 2, (move.y1 + move.y2) / 2) != 0) return false;
+        if (dx != 0 && dy != 0) // 车走法, 若横纵坐标都不相同, 则一定不合理
+            return false;
+        if (dx == 0)
+        {
+            REGION_ROOK region = this->bitboard->getRookRegion(this->getBitLineX(x1), y1, 9);
+            if (y2 < region[0] || y2 > region[1]) return false;
+        }
+        else
+        {
+            REGION_ROOK region = this->bitboard->getRookRegion(this->getBitLineY(y1), x1, 8);
+            if (x2 < region[0] || x2 > region[1]) return false;
+        }
     }
-    else if (abs(attacker) == R_CANNON)
+    else if (attacker == R_CANNON)
     {
-        if (move.x1 != move.x2 && move.y1 != move.y2) // 炮走法, 若横纵坐标都不同, 则一定不合理
+        if (dx != 0 && dy != 0) // 炮走法, 若横纵坐标都不同, 则一定不合理
             return false;
-        // 生成炮的着法范围
-        UINT32 bitlineX = this->getBitLineX(move.x1);
-        REGION_CANNON regionX = this->bitboard->getCannonRegion(bitlineX, move.y1, 9);
-        if ((move.y2 <= regionX[1] || move.y2 >= regionX[2] + 1) && move.y2 != regionX[0] && move.y2 != regionX[3]) return false;
-        // 横向
-        UINT32 bitlineY = this->getBitLineY(move.y1);
-        REGION_CANNON regionY = this->bitboard->getCannonRegion(bitlineY, move.x1, 8);
-        if ((move.x2 <= regionY[1] || move.x2 >= regionY[2]) && move.x2 != regionY[0] && move.x2 != regionY[3]) return false;
+        // 不吃子时只能走到空位范围内, 吃子时必须隔一个炮架
+        REGION_CANNON region = dx == 0 ? this->bitboard->getCannonRegion(this->getBitLineX(x1), y1, 9)
+                                       : this->bitboard->getCannonRegion(this->getBitLineY(y1), x1, 8);
+        const int target = dx == 0 ? y2 : x2;
+        if (capturedTeam == EMPTY_TEAM)
+        {
+            if (target < region[1] || target > region[2]) return false;
+        }
+        else
+        {
+            const bool lower = target == region[0] && region[0] != region[1];
+            const bool upper = target == region[3] && region[3] != region[2];
+            if (!lower && !upper) return false;
+        }
+    }
+    else if (attacker == R_PAWN)
+    {
+        // 兵只能前进一步, 过河后可以横走一步
+        const int forward = this->team == RED ? 1 : -1;
+        const bool crossed = this->team == RED ? y1 > 4 : y1 < 5;
+        const bool valid = (dx == 0 && dy == forward) || (crossed && abs(dx) == 1 && dy == 0);
+        if (!valid) return false;
+    }
+
+    this->doMoveSimple(move);
+    const bool skip = inCheck(-this->team);
+    this->undoMoveSimple();
+
+    return !skip;
+}
+
+bool Board::isLegalMove(Move move, bool checked)
+{
+    // 被将军或者走将时, 只能走完再判断
+    const Piece& king = this->getPieceByType(this->team == RED ? R_KING : B_KING);
+    const bool kingMove = move.x1 == king.x && move.y1 == king.y;
+    if (!checked && !kingMove)
+    {
+        // 没有被将军时, 只有离开与将同线的位置(车、炮、对面将), 离开将的马腿位置,
+        // 或者走到与将同线的位置(成为炮架)才可能送将, 其余着法一定合法
+        const bool fromLine = move.x1 == king.x || move.y1 == king.y;
+        const bool fromKnightLeg = abs(move.x1 - king.x) == 1 && abs(move.y1 - king.y) == 1;
+        const bool toLine = move.x2 == king.x || move.y2 == king.y;
+        if (!fromLine && !fromKnightLeg && !toLine)
+        {
+            return true;
+        }
     }
 
     this->doMoveSimple(move);
@@ -1079,3 +947,85 @@ bool Board::isValidMoveInSituation(Move move)
 
     return !skip;
 }
+
+Move Board::getLeastAttacker(int x, int y, TEAM attackTeam) const
+{
+    // 按子力价值从小到大寻找 attackTeam 方能吃到 (x, y) 的棋子, 不考虑牵制
+    const int sq = x * 10 + y;
+    const int index = AttackTables::teamIndex(attackTeam);
+    const Bitboard& bb = *this->bitboard;
+    const AttackTables& tables = bb.getTables();
+    auto from = [x, y](const Bitboard90& attackers) {
+        const int pos = attackers.first();
+        return Move{pos / 10, pos % 10, x, y};
+    };
+
+    Bitboard90 attackers = tables.pawnSources[index][sq] & bb.getPieces(R_PAWN * attackTeam);
+    if (!attackers.empty())
+    {
+        return from(attackers);
+    }
+    attackers = tables.guardSteps[index][sq] & bb.getPieces(R_GUARD * attackTeam);
+    if (!attackers.empty())
+    {
+        return from(attackers);
+    }
+    attackers = bb.bishopAttacks(attackTeam, sq) & bb.getPieces(R_BISHOP * attackTeam);
+    if (!attackers.empty())
+    {
+        return from(attackers);
+    }
+    attackers = bb.knightSources(sq) & bb.getPieces(R_KNIGHT * attackTeam);
+    if (!attackers.empty())
+    {
+        return from(attackers);
+    }
+    attackers = bb.cannonCaptures(x, y) & bb.getPieces(R_CANNON * attackTeam);
+    if (!attackers.empty())
+    {
+        return from(attackers);
+    }
+    attackers = bb.rookAttacks(x, y) & bb.getPieces(R_ROOK * attackTeam);
+    if (!attackers.empty())
+    {
+        return from(attackers);
+    }
+    attackers = tables.kingSteps[index][sq] & bb.getPieces(R_KING * attackTeam);
+    if (!attackers.empty())
+    {
+        return from(attackers);
+    }
+
+    return Move{};
+}
+
+int Board::see(Move move)
+{
+    // 静态交换评估, 双方轮流用最小的棋子在目标格上兑换, 任何一方都可以随时停止兑换
+    const int x = move.x2;
+    const int y = move.y2;
+    std::array<int, 34> gain{};
+    int depth = 0;
+    gain[0] = SEE_VALUE[abs(this->pieceidOn(x, y))];
+    int onSquare = SEE_VALUE[abs(this->pieceidOn(move.x1, move.y1))];
+    this->doMoveSimple(move);
+    int made = 1;
+    for (Move next = this->getLeastAttacker(x, y, this->team); next.id() != -1; next = this->getLeastAttacker(x, y, this->team))
+    {
+        depth++;
+        gain[depth] = onSquare - gain[depth - 1];
+        onSquare = SEE_VALUE[abs(this->pieceidOn(next.x1, next.y1))];
+        this->doMoveSimple(next);
+        made++;
+    }
+    for (; made > 0; made--)
+    {
+        this->undoMoveSimple();
+    }
+    // 从最后一次兑换往回推, 每一方都选择 停止 与 继续兑换 中较好的一个
+    for (; depth > 0; depth--)
+    {
+        gain[depth - 1] = -std::max<int>(-gain[depth - 1], gain[depth]);
+    }
+    return gain[0];
+}
@@ -0,0 +1,382 @@
+﻿#pragma once
+#include "board.hpp"
+
+// 开局库
+// 支持两种格式, 打开时根据文件头区分:
+// 1. ElephantEye 格式: 按32位局面校验码升序排列的定长记录, 只有着法和权重
+// 2. Chess98 格式: 16字节文件头之后是按64位局面键和着法升序排列的定长记录, 带有胜和负局数,
+//    由 tools/book 下的建库工具生成
+// 打开时整个文件映射到内存, 查询时直接在映射的记录数组上二分查找, 不再逐条读取文件
+class OpenBook
+{
+public:
+    OpenBook() = default;
+    OpenBook(const OpenBook&) = delete;
+    OpenBook& operator=(const OpenBook&) = delete;
+    ~OpenBook() { this->close(); }
+
+public:
+    // ElephantEye 格式的一条记录: 局面校验码, 着法(源格和目标格各8位), 权重
+    struct Record
+    {
+        uint32_t lock;
+        uint16_t move;
+        uint16_t vl;
+    };
+    static_assert(sizeof(Record) == 8, "BOOK.DAT record must be 8 bytes");
+
+    // Chess98 格式的文件头和记录
+    // 着法按 x1, y1, x2, y2 各占4位; 胜和负局数从走这步棋的一方来看, 超过16位时等比例缩小
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;
+    };
+    struct Entry
+    {
+        uint64_t key;
+        uint16_t move;
+        uint16_t win;
+        uint16_t draw;
+        uint16_t loss;
+    };
+    static_assert(sizeof(Header) == 16, "book header must be 16 bytes");
+    static_assert(sizeof(Entry) == 16, "book entry must be 16 bytes");
+
+    static constexpr const char* DEFAULT_PATH = "BOOK.DAT";
+    static constexpr const char MAGIC[8] = {'C', '9', '8', 'B', 'O', 'O', 'K', '\0'};
+    // 版本2起使用64位 Zobrist 键
+    static const uint32_t VERSION = 2;
+
+public:
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return this->count > 0; }
+    bool isLegacy() const { return this->entries == nullptr; }
+    size_t size() const { return this->count; }
+    // 局面的全部库着法, 按权重从大到小排列, 找不到时尝试左右镜像的局面
+    std::vector<Result> probe(const Board& board) const;
+    // 按权重随机选择一个库着法, 没有可用着法时返回分值 -1
+    Result pick(const Board& board, const std::unordered_map<int, bool>& bannedMoves) const;
+
+public:
+    // Chess98 格式的局面键即棋盘的64位 Zobrist 键, mirror 为真时计算左右镜像局面的键
+    static uint64_t positionKey(const Board& board, bool mirror = false);
+    // ElephantEye 格式使用的32位校验码, 只在查询时从头计算
+    static uint32_t legacyLock(const Board& board, bool mirror = false);
+    static uint16_t encodeMove(Move move);
+    static Move decodeEntryMove(uint16_t move, bool mirror);
+    // 选择着法时的权重, 胜局计2分, 和局计1分
+    static int entryWeight(const Entry& entry) { return int(entry.win) * 2 + int(entry.draw); }
+
+public:
+    // 进程内共享的默认开局库, 第一次使用时映射, 之后所有搜索对象共用
+    static std::shared_ptr<OpenBook> shared()
+    {
+        static std::shared_ptr<OpenBook> book = []() {
+            auto b = std::make_shared<OpenBook>();
+            b->open(OpenBook::DEFAULT_PATH);
+            return b;
+        }();
+        return book;
+    }
+
+protected:
+    const Record* records = nullptr;
+    const Entry* entries = nullptr;
+    size_t count = 0;
+    void* view = nullptr;
+    size_t viewBytes = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+#endif
+    // 无法映射时把整个文件读入内存
+    std::vector<char> loaded{};
+
+protected:
+    bool attach(const char* data, size_t bytes);
+    static Move decodeMove(uint16_t move, bool mirror);
+    void collect(uint32_t lock, bool mirror, std::vector<Result>& moves) const;
+    void collectEntries(uint64_t key, bool mirror, std::vector<Result>& moves) const;
+};
+
+bool OpenBook::open(const std::string& path)
+{
+    this->close();
+#ifdef _WIN32
+    this->fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (this->fileHandle != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER fileSize{};
+        if (GetFileSizeEx(this->fileHandle, &fileSize) && fileSize.QuadPart >= LONGLONG(sizeof(Record)))
+        {
+            this->mappingHandle = CreateFileMappingA(this->fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (this->mappingHandle != nullptr)
+            {
+                this->view = MapViewOfFile(this->mappingHandle, FILE_MAP_READ, 0, 0, 0);
+                this->viewBytes = size_t(fileSize.QuadPart);
+            }
+        }
+    }
+#elif __unix__
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Record))
+        {
+            void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                // 查询是随机访问, 库不大时一次性读入页缓存
+                madvise(p, size_t(st.st_size), MADV_WILLNEED);
+                this->view = p;
+                this->viewBytes = size_t(st.st_size);
+            }
+        }
+        ::close(fd);
+    }
+#endif
+    if (this->view != nullptr)
+    {
+        return this->attach(static_cast<const char*>(this->view), this->viewBytes);
+    }
+    this->close();
+
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    const size_t bytes = size_t(file.tellg());
+    file.seekg(0, std::ios::beg);
+    // 按8字节对齐分配, 记录数组可以直接指向缓冲区
+    this->loaded.resize(bytes + alignof(Entry));
+    const size_t offset = (alignof(Entry) - reinterpret_cast<uintptr_t>(this->loaded.data()) % alignof(Entry)) % alignof(Entry);
+    file.read(this->loaded.data() + offset, std::streamsize(bytes));
+    return this->attach(this->loaded.data() + offset, bytes);
+}
+
+bool OpenBook::attach(const char* data, size_t bytes)
+{
+    if (bytes >= sizeof(Header) && std::memcmp(data, OpenBook::MAGIC, sizeof(OpenBook::MAGIC)) == 0)
+    {
+        Header header{};
+        std::memcpy(&header, data, sizeof(Header));
+        const size_t n = std::min<size_t>(header.count, (bytes - sizeof(Header)) / sizeof(Entry));
+        if (header.version != OpenBook::VERSION || n == 0)
+        {
+            this->close();
+            return false;
+        }
+        this->entries = reinterpret_cast<const Entry*>(data + sizeof(Header));
+        this->count = n;
+        return true;
+    }
+    this->records = reinterpret_cast<const Record*>(data);
+    this->count = bytes / sizeof(Record);
+    return this->count > 0;
+}
+
+void OpenBook::close()
+{
+    if (this->view != nullptr)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(this->view);
+#elif __unix__
+        munmap(this->view, this->viewBytes);
+#endif
+    }
+#ifdef _WIN32
+    if (this->mappingHandle != nullptr)
+    {
+        CloseHandle(this->mappingHandle);
+    }
+    if (this->fileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(this->fileHandle);
+    }
+    this->mappingHandle = nullptr;
+    this->fileHandle = INVALID_HANDLE_VALUE;
+#endif
+    this->view = nullptr;
+    this->viewBytes = 0;
+    this->loaded.clear();
+    this->loaded.shrink_to_fit();
+    this->records = nullptr;
+    this->entries = nullptr;
+    this->count = 0;
+}
+
+uint64_t OpenBook::positionKey(const Board& board, bool mirror)
+{
+    if (!mirror)
+    {
+        return board.hashKey;
+    }
+    // 左右镜像局面的键
+    uint64_t key = 0;
+    for (int x = 0; x < 9; x++)
+    {
+        for (int y = 0; y < 10; y++)
+        {
+            const PIECEID pid = board.pieceidOn(x, y);
+            if (pid != EMPTY_PIECEID)
+            {
+                key ^= zobristKey(pid, 8 - x, y);
+            }
+        }
+    }
+    if (board.team == BLACK)
+    {
+        key ^= PLAYER_ZOBRIST;
+    }
+    return key;
+}
+
+uint32_t OpenBook::legacyLock(const Board& board, bool mirror)
+{
+    int32 lock = 0;
+    for (int x = 0; x < 9; x++)
+    {
+        for (int y = 0; y < 10; y++)
+        {
+            const PIECEID pid = board.pieceidOn(x, y);
+            if (pid != EMPTY_PIECEID)
+            {
+                lock ^= hashLockOf(pid, mirror ? 8 - x : x, y);
+            }
+        }
+    }
+    if (board.team == BLACK)
+    {
+        lock ^= PLAYER_LOCK;
+    }
+    return static_cast<uint32_t>(lock);
+}
+
+uint16_t OpenBook::encodeMove(Move move)
+{
+    return uint16_t(move.x1 | (move.y1 << 4) | (move.x2 << 8) | (move.y2 << 12));
+}
+
+Move OpenBook::decodeEntryMove(uint16_t move, bool mirror)
+{
+    int x1 = move & 15;
+    int x2 = (move >> 8) & 15;
+    if (mirror)
+    {
+        x1 = 8 - x1;
+        x2 = 8 - x2;
+    }
+    return Move(x1, (move >> 4) & 15, x2, (move >> 12) & 15);
+}
+
+Move OpenBook::decodeMove(uint16_t move, bool mirror)
+{
+    // 库中的着法使用 16x16 的棋盘坐标
+    const int src = move & 255;
+    const int dst = move >> 8;
+    int xSrc = (src & 15) - 3;
+    const int ySrc = 12 - (src >> 4);
+    int xDst = (dst & 15) - 3;
+    const int yDst = 12 - (dst >> 4);
+    if (mirror)
+    {
+        xSrc = 8 - xSrc;
+        xDst = 8 - xDst;
+    }
+    return Move(xSrc, ySrc, xDst, yDst);
+}
+
+void OpenBook::collect(uint32_t lock, bool mirror, std::vector<Result>& moves) const
+{
+    const Record* first = this->records;
+    const Record* last = this->records + this->count;
+    const Record* lower = std::lower_bound(first, last, lock, [](const Record& r, uint32_t l) { return r.lock < l; });
+    for (const Record* r = lower; r != last && r->lock == lock; r++)
+    {
+        moves.emplace_back(OpenBook::decodeMove(r->move, mirror), int(r->vl));
+    }
+}
+
+void OpenBook::collectEntries(uint64_t key, bool mirror, std::vector<Result>& moves) const
+{
+    const Entry* first = this->entries;
+    const Entry* last = this->entries + this->count;
+    const Entry* lower = std::lower_bound(first, last, key, [](const Entry& e, uint64_t k) { return e.key < k; });
+    for (const Entry* e = lower; e != last && e->key == key; e++)
+    {
+        const int weight = OpenBook::entryWeight(*e);
+        if (weight > 0)
+        {
+            moves.emplace_back(OpenBook::decodeEntryMove(e->move, mirror), weight);
+        }
+    }
+}
+
+std::vector<Result> OpenBook::probe(const Board& board) const
+{
+    std::vector<Result> moves{};
+    if (!this->isOpen())
+    {
+        return moves;
+    }
+    if (this->isLegacy())
+    {
+        this->collect(OpenBook::legacyLock(board), false, moves);
+        if (moves.empty())
+        {
+            this->collect(OpenBook::legacyLock(board, true), true, moves);
+        }
+    }
+    else
+    {
+        this->collectEntries(OpenBook::positionKey(board), false, moves);
+        if (moves.empty())
+        {
+            this->collectEntries(OpenBook::positionKey(board, true), true, moves);
+        }
+    }
+    // 从大到小排序
+    std::sort(moves.begin(), moves.end(), [](const Result& a, const Result& b) { return a.vl > b.vl; });
+    return moves;
+}
+
+Result OpenBook::pick(const Board& board, const std::unordered_map<int, bool>& bannedMoves) const
+{
+    const std::vector<Result> moves = this->probe(board);
+    int vlSum = 0;
+    for (const Result& bookResult : moves)
+    {
+        vlSum += bookResult.vl;
+    }
+    if (vlSum <= 0)
+    {
+        return Result{Move{}, -1};
+    }
+
+    static thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_int_distribution<> dis(0, vlSum - 1);
+    int vlRandom = dis(gen);
+
+    Move bookMove{};
+    for (const Result& bookResult : moves)
+    {
+        vlRandom -= bookResult.vl;
+        if (vlRandom < 0)
+        {
+            bookMove = bookResult.move;
+            break;
+        }
+    }
+    if (bannedMoves.find(bookMove.id()) != bannedMoves.end())
+    {
+        return Result{Move{}, -1};
+    }
+    return Result{bookMove, 1};
+}
@@ -3,10 +3,8 @@
 #include "base.hpp"
 
 using WEIGHT_MAP = std::array<std::array<int, 10>, 9>;
-
-std::map<PIECEID, WEIGHT_MAP> pieceWeights;
-int vlAdvanced = 0;
-int vlPawn = 0;
+// 全部棋子的估值权重, 按 [pieceid + 7][x * 10 + y] 索引
+using PIECE_WEIGHTS = std::array<std::array<int, 90>, 15>;
 
 WEIGHT_MAP OPEN_ATTACK_KING_PAWN_WEIGHT = {{
     {0, 0, 0, 21, 21, 67, 97, 97, 97, 7},
@@ -171,7 +169,7 @@ const int END_PAWN_VAL = 120;
 
 // 实时计算红方视角的估值权重
 
-std::map<PIECEID, WEIGHT_MAP> getBasicEvaluateWeights(int vlOpen, int vlRedAttack, int vlBlackAttack)
+PIECE_WEIGHTS getBasicEvaluateWeights(int vlOpen, int vlRedAttack, int vlBlackAttack)
 {
     // 兵, 帅
     WEIGHT_MAP RED_KING_PAWN_WEIGHT = {0};
@@ -271,10 +269,62 @@ std::map<PIECEID, WEIGHT_MAP> getBasicEvaluateWeights(int vlOpen, int vlRedAttac
         }
     }
 
-    return {
-        {R_KING, RED_KING_PAWN_WEIGHT},        {R_GUARD, RED_GUARD_BISHOP_WEIGHT}, {R_BISHOP, RED_GUARD_BISHOP_WEIGHT},
-        {R_KNIGHT, RED_KNIGHT_WEIGHT},         {R_ROOK, RED_ROOK_WEIGHT},          {R_CANNON, RED_CANNON_WEIGHT},
-        {R_PAWN, RED_KING_PAWN_WEIGHT},        {B_KING, BLACK_KING_PAWN_WEIGHT},   {B_GUARD, BLACK_GUARD_BISHOP_WEIGHT},
-        {B_BISHOP, BLACK_GUARD_BISHOP_WEIGHT}, {B_KNIGHT, BLACK_KNIGHT_WEIGHT},    {B_ROOK, BLACK_ROOK_WEIGHT},
-        {B_CANNON, BLACK_CANNON_WEIGHT},       {B_PAWN, BLACK_KING_PAWN_WEIGHT}};
+    PIECE_WEIGHTS weights{};
+    auto setWeights = [&weights](PIECEID pid, const WEIGHT_MAP& map) {
+        for (int x = 0; x < 9; x++)
+        {
+            for (int y = 0; y < 10; y++)
+            {
+                weights[size_t(pid + 7)][size_t(x * 10 + y)] = map[x][y];
+            }
+        }
+    };
+    setWeights(R_KING, RED_KING_PAWN_WEIGHT);
+    setWeights(R_GUARD, RED_GUARD_BISHOP_WEIGHT);
+    setWeights(R_BISHOP, RED_GUARD_BISHOP_WEIGHT);
+    setWeights(R_KNIGHT, RED_KNIGHT_WEIGHT);
+    setWeights(R_ROOK, RED_ROOK_WEIGHT);
+    setWeights(R_CANNON, RED_CANNON_WEIGHT);
+    setWeights(R_PAWN, RED_KING_PAWN_WEIGHT);
+    setWeights(B_KING, BLACK_KING_PAWN_WEIGHT);
+    setWeights(B_GUARD, BLACK_GUARD_BISHOP_WEIGHT);
+    setWeights(B_BISHOP, BLACK_GUARD_BISHOP_WEIGHT);
+    setWeights(B_KNIGHT, BLACK_KNIGHT_WEIGHT);
+    setWeights(B_ROOK, BLACK_ROOK_WEIGHT);
+    setWeights(B_CANNON, BLACK_CANNON_WEIGHT);
+    setWeights(B_PAWN, BLACK_KING_PAWN_WEIGHT);
+    return weights;
 }
+
+// 估值上下文
+// 由棋盘根据局面所处阶段生成, 生成后不再修改; 复制棋盘时共享同一个上下文,
+// 同一进程中的多个棋盘和搜索线程可以各自持有不同的上下文, 互不干扰
+class EvaluateContext
+{
+public:
+    EvaluateContext() = default;
+    EvaluateContext(int vlOpen, int vlRedAttack, int vlBlackAttack)
+        : weights(getBasicEvaluateWeights(vlOpen, vlRedAttack, vlBlackAttack)),
+          vlAdvanced((TOTAL_ADVANCED_VALUE * vlOpen + TOTAL_ADVANCED_VALUE / 2) / TOTAL_MIDGAME_VALUE),
+          vlPawn((vlOpen * OPEN_PAWN_VAL + (TOTAL_MIDGAME_VALUE - vlOpen) * END_PAWN_VAL) / TOTAL_MIDGAME_VALUE)
+    {
+    }
+
+public:
+    const PIECE_WEIGHTS weights{};
+    // 先行权分
+    const int vlAdvanced = 0;
+    // 兵的基础分, 随局面阶段在开局和残局之间插值
+    const int vlPawn = 0;
+
+public:
+    int weight(PIECEID pid, int x, int y) const { return weights[size_t(pid + 7)][size_t(x * 10 + y)]; }
+
+public:
+    // 尚未初始化估值的棋盘使用的空上下文
+    static const std::shared_ptr<const EvaluateContext>& empty()
+    {
+        static const std::shared_ptr<const EvaluateContext> context = std::make_shared<const EvaluateContext>();
+        return context;
+    }
+};
@@ -1,29 +1,46 @@
 ﻿#pragma once
 #include "base.hpp"
 
-const int32 PLAYER_KEY = 1099503838;
-const int32 PLAYER_LOCK = 1730021002;
+// 64位 Zobrist 键, 编译期用 splitmix64 生成
+// 按 [pieceid + 7][x * 10 + y] 索引, 空位和走棋方不占用棋子的位置
+class ZobristTable
+{
+public:
+    constexpr ZobristTable() : keys{}, player(0)
+    {
+        uint64 state = 0x9E3779B97F4A7C15ULL;
+        for (int pid = 0; pid < 15; pid++)
+        {
+            for (int pos = 0; pos < 90; pos++)
+            {
+                keys[pid][pos] = pid == 7 ? 0 : next(state);
+            }
+        }
+        player = next(state);
+    }
 
-HASH_KEY_MAP RED_KING_KEY{{
-    {-452590845, 1299605853, 1796899501, -39638184, 949696210, -15630479, -2003496695, 779088422, -2006994967,
-     -2110139350},
-    {-1616609639, -660883342, 1444950449, -1502282445, -2083839465, -1885777508, -1474274804, 553434557, -1224570321,
-     -656005916},
-    {1785243510, 565976965, 935604082, 1573041728, -1749462381, 2060916673, 1864434484, -1710117322, 1468943459,
-     -907239204},
-    {1016030977, -972036535, -1242171326, -751933200, -105679457, 641395140, 1980006590, -863360147, -1533160346,
-     800229219},
-    {-1147535822, -1253631474, 1098466456, 1346271330, -1143396719, -1119565115, 2035407052, 1211606766, -886144963,
-     -943936683},
-    {-407987356, -245902546, 1580703444, 1316821498, -534772856, -267919219, -467902036, 1653309922, 392631310,
-     1678347659},
-    {888456021, 1874588123, -1205570047, 1580541542, 995140339, 1416952072, -993262641, -1727926504, 621978617,
-     -32676465},
-    {655684412, 798952515, 2128222368, -1974990051, -1629788970, -855499169, 705669752, 1726418834, -1768421406,
-     320294254},
-    {-880419933, -1958347398, 2109896293, -1739488072, -685755967, -1246776628, -1129797252, -491413088, -740816970,
-     -271775671},
-}};
+public:
+    uint64 keys[15][90];
+    uint64 player;
+
+protected:
+    static constexpr uint64 next(uint64& state)
+    {
+        state += 0x9E3779B97F4A7C15ULL;
+        uint64 z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+};
+
+constexpr ZobristTable ZOBRIST{};
+constexpr uint64 PLAYER_ZOBRIST = ZOBRIST.player;
+
+inline uint64 zobristKey(PIECEID pid, int x, int y) { return ZOBRIST.keys[pid + 7][x * 10 + y]; }
+
+// 以下是 ElephantEye 开局库使用的32位校验码, 只在查询旧格式的开局库时使用
+const int32 PLAYER_LOCK = 1730021002;
 
 HASH_KEY_MAP RED_KING_LOCK{{
     {-1054092100, 427473234, -771606168, 224169168, -569575499, -894936381, 636798793, -209068393, -431850128,
@@ -45,27 +62,6 @@ HASH_KEY_MAP RED_KING_LOCK{{
      -645796495},
 }};
 
-HASH_KEY_MAP RED_GUARD_KEY{{
-    {-435838278, 1077558601, 2051066955, 224713614, -1586129741, -1050849437, -143368794, -1607934338, 1742750290,
-     212893695},
-    {-1630707737, -1888511300, 1363435427, -395818309, 372191438, 1340969939, -172499425, 1750452933, -1559507636,
-     46107567},
-    {1179454818, 20695334, -2138888357, 304757360, 1350891490, 208324415, 223386095, 774297844, -1778331423,
-     -615740912},
-    {1947221458, -612024992, 723020611, 354516600, 1882441975, 1435679943, 252413981, -502548246, -1228518572,
-     1677090843},
-    {-1290732152, 1431238689, -610576725, 15421666, 596583646, -1869145403, 1574109447, 1551894725, 552602541,
-     -780919732},
-    {187653918, -1302569491, -1224658579, -415861860, 644621784, -1186176133, 764866318, -468955914, -437554344,
-     1986677522},
-    {-1249056703, -2094596477, 953682832, 1719864919, 2074135885, 210688441, 1696842172, -1994018128, 1073121449,
-     2086484614},
-    {-130069352, -662925369, -349550844, -2121778413, 1974619084, 788508422, -2021713509, -1420213157, -167534582,
-     -1842973823},
-    {-2051939473, 1305632258, 723628038, 1664667516, 151249312, 1967175186, 635575215, 628130368, -564031284,
-     856182188},
-}};
-
 HASH_KEY_MAP RED_GUARD_LOCK{{
     {470563629, 1237721119, -567762239, 1791581783, 834977102, -853365684, 1241675471, 90753603, -643797388,
      -1424127415},
@@ -86,26 +82,6 @@ HASH_KEY_MAP RED_GUARD_LOCK{{
      -1165564612},
 }};
 
-HASH_KEY_MAP RED_BISHOP_KEY{{
-    {-261700424, -49448170, 811946502, 1537487454, -875168554, -1832061763, -1014621002, 2082366036, 76256774,
-     -586532279},
-    {1507417490, -1538875355, -1384996830, 63691370, 1575665762, 592780588, -871592753, -1071133893, -1761917306,
-     816462447},
-    {1449099202, 1943197169, 1910650549, 82878311, -136056859, -1661963291, -514749717, -1878269824, 1119336988,
-     -1317931321},
-    {-998168085, 1122167115, 717532448, 899846592, 1097114312, -1457637029, -1318643006, -152203867, -1383621570,
-     110009889},
-    {-2066557063, 2047317128, 1090032827, 1050568651, -1761550616, -61377070, -346057939, 1980700417, 262808972,
-     -433345681},
-    {-1380652549, 2001046298, 787557945, -2049760192, 957017355, -2081962535, -1068710465, -40790018, 1162242379,
-     -313511444},
-    {-1729910140, 1089993096, -1199133378, 947799064, -502852252, 682562734, -1572499791, -976239982, 797342424,
-     1014935569},
-    {1614453341, -254829813, 176307087, -1375748434, 435779414, 360466746, 977871685, -613975158, 1116703664,
-     -1820350277},
-    {1721799519, -740565717, 141624756, 652323927, 378967660, 1294526077, 844488099, -493070232, -399513802, 247372276},
-}};
-
 HASH_KEY_MAP RED_BISHOP_LOCK{{
     {-1120879978, -30153141, -2128392046, -1154583043, -1007178103, -1084376477, 873350878, -1232949879, -1457852803,
      -562942189},
@@ -127,27 +103,6 @@ HASH_KEY_MAP RED_BISHOP_LOCK{{
      -1382025881},
 }};
 
-HASH_KEY_MAP RED_KNIGHT_KEY{{
-    {892024182, -1527857169, -819431040, 761684063, -1326637709, 1817966057, 1615271764, -1045335818, -252737795,
-     1203808473},
-    {-1670912359, -1887709652, -1697622183, 1741026182, 995543623, -361171708, -1618263006, -1213713471, 2082393394,
-     1610017208},
-    {1669383628, -1541994149, 94826874, -2834378, 1513226292, -1059480412, -651775267, 1300617365, 271104021,
-     -1977679266},
-    {459632335, -995377529, -281719275, -1867899931, 685522964, 1288981949, -1573036110, 1019084519, 972595173,
-     -1118535200},
-    {1176681872, 1425643025, -1673604203, 1197709357, 46097576, 1202930717, -342227719, 106441414, 6535597,
-     -1851333085},
-    {1096637023, -133533395, -688012178, 1108869936, 41961677, 1465043503, 959456510, -554572770, 1188476013,
-     1773886979},
-    {-1975609495, 1807692726, 584181641, -619119543, 569617244, 1943828718, -1830957702, -465663878, 338361905,
-     -1709008885},
-    {1893196896, -408633564, -2016332958, -1605950012, -1875473389, -1162165701, 1833991898, -616286425, 616870331,
-     2070411951},
-    {1068677344, 763846272, 1748766047, 1707812556, -1173771638, -1754847006, -1663961100, 1045087496, 850599257,
-     272597709},
-}};
-
 HASH_KEY_MAP RED_KNIGHT_LOCK{{
     {-827911810, 888493919, -1368858259, 2051822552, -678017895, -902629882, -1437882478, 824982001, -268546132,
      432096688},
@@ -169,26 +124,6 @@ HASH_KEY_MAP RED_KNIGHT_LOCK{{
      -136725419},
 }};
 
-HASH_KEY_MAP RED_ROOK_KEY{{
-    {960694496, 157647582, 709526779, -612742563, -186975353, 332564926, 606972938, 908410955, -971103739, 2081595949},
-    {170193394, -1031639818, 166878137, -121680178, -440763408, -1107041597, -379459256, 913475628, 2089665346,
-     -1746964650},
-    {-1092541309, 1729215430, -1451688800, 973985578, 1365907952, 1648163767, -645169563, -1466233142, 931129124,
-     1541376136},
-    {-439440387, 782137545, -1787209426, -1707437508, 1656950866, 1845403059, 259496800, 1917744222, -1348905620,
-     -110414945},
-    {995645470, -437190988, -441150185, -592427716, 2043319991, 1787070339, -1640386760, -533183542, -1819250986,
-     -656655688},
-    {159758256, -104180349, -1555117963, -1943724685, -1013990229, 544663147, -1973435386, 914255835, 1460342140,
-     -618053774},
-    {-163740021, -953741562, 839362741, -2053920724, -338605781, 910185940, -601225905, -1995820574, -1998316309,
-     1631811406},
-    {-1176254809, 1195087321, 370776407, -639671352, -759392890, 49957996, 1226135389, -2109345646, 424707512,
-     -1057473055},
-    {948928387, -736688034, 1244444276, -1318532357, 1261982680, -1042542491, 976424639, 1744504299, 1822424766,
-     530898366},
-}};
-
 HASH_KEY_MAP RED_ROOK_LOCK{{
     {1687555682, 1328376985, -283833814, 572241585, -1191120689, 154342584, 405977822, -1900867871, -738023096,
      -1161444119},
@@ -209,27 +144,6 @@ HASH_KEY_MAP RED_ROOK_LOCK{{
      -1173133215},
 }};
 
-HASH_KEY_MAP RED_CANNON_KEY{{
-    {-1190868744, -1127145879, 1351352970, 1512137332, -2099261571, 1081621145, -2127780635, 1117656583, -350639927,
-     417818638},
-    {105961934, 915780536, -259817464, 1993689109, -26664676, -112268515, -1335630937, -941829520, 157547523,
-     -249821726},
-    {-1138785893, -1575181674, -343549167, 1356571936, 1318992042, 1099785095, -128646940, 1664755627, -1246815554,
-     -376497795},
-    {707933839, -1665980429, 202921340, -688508159, 520787296, 1486840498, 1763287087, -1840435034, 590717485,
-     -1242320325},
-    {-1280440036, 32102695, 1341642480, -1513586036, 1159017984, 1339245528, -1207190714, -1768157405, -1191494702,
-     2058765531},
-    {704905056, 2091418243, -1150443664, 71972738, -956869919, 1926038882, 679023582, -1824954258, -2019680082,
-     -1624113588},
-    {82024831, 626878430, 90725599, -1885030261, -1755384116, 29717462, 536110190, 1050973172, -1468510348,
-     -1379674152},
-    {-1513778491, 1559580984, 178329159, 1245526341, 62739324, -1540229006, 414383341, 1806409648, -523336441,
-     1492477664},
-    {-1443655636, 1458755468, -1425005759, -1620574070, 661201470, -916661099, 2080193799, 1759835165, 998454919,
-     1206222998},
-}};
-
 HASH_KEY_MAP RED_CANNON_LOCK{{
     {429480283, -1431207022, -491564558, -386680714, 95005527, -639446976, 85300860, -1777548634, 266231758,
      -726422328},
@@ -250,27 +164,6 @@ HASH_KEY_MAP RED_CANNON_LOCK{{
      -2108831154},
 }};
 
-HASH_KEY_MAP RED_PAWN_KEY{{
-    {-353017946, 1438787195, 405008092, 855268380, -1902380244, -361451900, 835150904, -375059298, 1620664161,
-     920614180},
-    {-527426994, 59879161, -402849554, 2020665555, -284164382, 1115895263, -1671573308, 1471360033, 28832284,
-     2014996780},
-    {-964809654, -1276289730, 1071254315, 864463621, -204509861, -718684339, 425387610, 1295670370, 226394081,
-     -1545611811},
-    {-270951563, 14190882, 1172082835, -123271435, -692628382, -905411840, -1701025661, -1920428158, -401062053,
-     566452354},
-    {-1780377759, 2060992195, -1369119929, -1060182707, -2124581281, -843549065, 583940778, -681316740, 537960585,
-     1962916267},
-    {-1588196975, 61476809, 1496046203, -1971823635, -2101088176, -1620513215, 1886678976, 1898665073, 1530410644,
-     1791762519},
-    {699073964, -1944363775, 1799683304, -619933724, 900892001, -1214077329, -1776654611, 987084801, 714279378,
-     1807696252},
-    {1428961540, -2054084571, -330764686, 1192439345, -2014536082, -720167764, -411295031, -758301329, -1140705414,
-     2064863877},
-    {-1609253965, -1026551945, 1712354826, 1871159185, -1667637607, 879565340, -1133746518, 601821714, 1921497351,
-     622125752},
-}};
-
 HASH_KEY_MAP RED_PAWN_LOCK{{
     {822471317, 868014183, -1013300214, 155918241, 1827760164, 1175107196, 639575785, -1297688637, -1782683114,
      791201856},
@@ -291,26 +184,6 @@ HASH_KEY_MAP RED_PAWN_LOCK{{
      -243041912},
 }};
 
-HASH_KEY_MAP BLACK_KING_KEY{{
-    {-1743479229, 1681483750, -1264392569, -281443093, 1911699190, 1893278473, 61612059, -587203350, 902595434,
-     1245581586},
-    {-1344558745, 601622911, 1691357037, -1873960487, -1696418724, -803732548, 951066750, 84193110, -421987591,
-     648751439},
-    {166565641, -977244999, -1958351043, -1692834316, 27386369, 1561746785, 93391111, 1368250641, -1252297783,
-     -67490110},
-    {-949650223, -878148756, 1379288872, 69808878, 34528982, 1443343349, -983027203, 1071953585, -442047091, -82841739},
-    {249270616, -977783124, -1596327128, 556870365, -1013884979, 114171658, 1355729124, 579999492, 111500502,
-     -1831936938},
-    {1966995791, -1115421442, 863770993, -1059985456, -1599004063, -515101871, -1289912028, -305843780, 1668250769,
-     -2082543594},
-    {-2053172341, -2131082148, 188689794, -1426399028, 1232124727, 693003481, 487207679, -1772929788, -108555252,
-     -804537284},
-    {-803202769, 1043475297, -1463638422, 1109615178, 915877963, -989166276, -465094287, 998191457, 463257327,
-     1593801582},
-    {1645413420, -1945599482, -532665330, -211694158, 1219133040, -7753935, 2058365437, -214361310, 1766343201,
-     -867242518},
-}};
-
 HASH_KEY_MAP BLACK_KING_LOCK{{
     {-274287040, -2084958308, -1456867466, 1144248026, -1523199131, 926644380, -1476893754, -1501138984, -171857819,
      -2056844925},
@@ -332,26 +205,6 @@ HASH_KEY_MAP BLACK_KING_LOCK{{
      316134898},
 }};
 
-HASH_KEY_MAP BLACK_GUARD_KEY{{
-    {-869625450, 666739321, 1240490028, 2061903285, 378781891, 1564725311, 1888561422, 1979198865, 1463336775,
-     -952859761},
-    {-1212765647, -1516021477, 1675569753, -131934578, -566833520, 1394285490, -979043625, 753914445, -390718102,
-     1950251985},
-    {1090663643, -197471496, 252678621, 431376501, 1071471510, 557104151, -429991485, 1420321885, 1114471000,
-     1151938899},
-    {1653733982, -328699728, 738125302, 989408054, 109651052, -49237376, -1856028611, 51775976, -1980553151, 932512957},
-    {-479319429, 130129346, -15884811, -1225689099, -565669382, 126385613, 1590687558, -1301895743, -1736237019,
-     -1359107389},
-    {-886931420, 791236078, -102679946, -1102462938, 800113652, -454956353, -44092451, 780082757, 1198953426,
-     1354958082},
-    {-1027290655, -546883317, 1274059574, -671735808, 923400352, 1864106184, -2042330944, -301789257, -243988851,
-     97583562},
-    {-1708355329, 203647750, -1304203179, 865648735, -718192892, 936172837, 1337669405, -1388708391, -13721339,
-     -1771852612},
-    {280641813, 1635799317, 552724521, 637580813, -1384857674, -1432220227, -681688517, 1304186446, 1498567953,
-     -583109787},
-}};
-
 HASH_KEY_MAP BLACK_GUARD_LOCK{{
     {1759161891, 583240734, -1113056614, 508710003, -865041135, -2112913027, -975328402, 1229180205, -1202502560,
      605556732},
@@ -373,27 +226,6 @@ HASH_KEY_MAP BLACK_GUARD_LOCK{{
      1399606628},
 }};
 
-HASH_KEY_MAP BLACK_BISHOP_KEY{{
-    {238158000, -848945525, -683470507, 103291912, 1695285885, -278587444, 254261404, -2050226347, 1969992812,
-     -102047188},
-    {2024765861, -1033726608, -1980534442, -2074182772, 1768943042, 1886548392, 1062354765, 1659888244, 1472862386,
-     -1308676134},
-    {-712165230, -2099164865, 1315832221, -1373628819, 866416822, -1016322022, 1635905745, -373233206, -1306876412,
-     32140257},
-    {-754252079, -1416737965, -1526984186, -275873952, 1249736575, 684726732, -1115618988, 2055439371, 981976634,
-     -1903554170},
-    {2015374694, 1421866686, -442106329, 374901085, 279441017, 1745829824, -1308916950, 1478563442, 623265739,
-     1790209256},
-    {2105630222, -1931086226, -871593887, -313597884, -113256813, -521014247, 1889597570, 108339902, -736134966,
-     615784743},
-    {267410938, 2095537720, -1008049023, -1871735006, 969090705, 335860666, 652772634, -1791808362, -505325402,
-     1179628880},
-    {-2088649369, 1884016570, -843355582, 799586206, 1251143207, 1126094137, 1238106967, -515788909, -221569369,
-     1545383988},
-    {73827305, -1922434260, -1294195555, -2061315733, -608959641, -1496841323, -1537700996, 1376754154, 1312978055,
-     -1622163768},
-}};
-
 HASH_KEY_MAP BLACK_BISHOP_LOCK{{
     {1289042696, -1063378397, -1172213253, -1150631765, 1219490387, -406003727, -363786034, 299127000, -358262248,
      -1674734962},
@@ -415,27 +247,6 @@ HASH_KEY_MAP BLACK_BISHOP_LOCK{{
      -611769659},
 }};
 
-HASH_KEY_MAP BLACK_KNIGHT_KEY{{
-    {-1247038044, -254637536, 322835461, -2068459350, -943990281, -1888227712, 341537779, 1139420504, -270957381,
-     1843995589},
-    {1923930203, -897177865, 867531436, -1746388354, -687315105, -1366232826, -476135765, -1880770851, 270884619,
-     -996025856},
-    {-260221337, -1594764772, 1406447120, 819339764, -2128859553, 160084035, 1512195058, -1432578058, 1827128943,
-     731241132},
-    {506572067, 1986738274, -359389706, 1126976781, -2096020444, -1195482942, -955434068, 1312763178, 1823443434,
-     1266210735},
-    {-452419304, -600676768, -1936939197, 16015841, 1864163342, 572539806, -216692191, 371819915, -621567358,
-     2005150024},
-    {-2048940693, -2102621698, 1969864771, 140772315, -1906236437, -103856682, -2120725522, -1187765651, -616645753,
-     138867313},
-    {-1090707956, 959611417, -12834039, -816354119, 707565461, 2081968078, -1667472376, -185005481, 1632136330,
-     -173277584},
-    {728262332, 488701381, -1772441820, 1616695993, -664861932, 2005094638, -126016111, 1379167762, -2073605931,
-     432614703},
-    {1028311088, 1493563905, 749942217, -1768449802, 1098640717, 494978951, 1097110449, 1981329643, -2087718638,
-     1585928954},
-}};
-
 HASH_KEY_MAP BLACK_KNIGHT_LOCK{{
     {-848696704, -1054044265, -1448415807, -1009884589, 211278807, -1210273622, 1341476719, 763786087, 1471963489,
      1215785764},
@@ -457,27 +268,6 @@ HASH_KEY_MAP BLACK_KNIGHT_LOCK{{
      1233382892},
 }};
 
-HASH_KEY_MAP BLACK_ROOK_KEY{{
-    {999259941, -1670485150, -84910777, 1393817382, 812992526, -1320252893, 1819393983, -1005838448, 965762800,
-     -1490458314},
-    {-392207586, 1301220589, -1730847212, 1494439085, -874659111, -1304577812, 2144459702, -1663111142, 557411293,
-     536825660},
-    {-1824710258, -1826986523, -1169963682, 126717520, -1219138989, -1495786904, 1580267631, -1900582019, 2071690766,
-     -142731046},
-    {-477119139, 1356377552, 795590728, 1666560020, 1715358872, -1597272819, -1918374361, 342790995, -1551311966,
-     969570561},
-    {-187781840, 1967634641, 1716999963, -1158414437, 618951686, -1337875296, 1820682936, 761205996, 539652492,
-     -35467546},
-    {-1529419527, -301462161, 341064093, 992658599, -2076938959, -206134563, -663705646, -1787955899, -372179726,
-     1891009436},
-    {-523047619, 852297955, 1122125780, -1598906634, 1141821198, -1087947068, 1147736990, 1090332189, 1908168420,
-     1579191695},
-    {-771236745, 764930838, -1288836586, -1669946266, -171010388, -171046030, 575392449, -539417848, -1279356,
-     906592713},
-    {-1645317351, -304059361, -268808384, -862445283, -1471847674, -988983863, 1242125720, 2101090113, 595060691,
-     -1310396283},
-}};
-
 HASH_KEY_MAP BLACK_ROOK_LOCK{{
     {919275208, 2068630669, 1285134224, -183474506, -724757867, -88693195, -22569596, 1620474079, 1904134726,
      -153311891},
@@ -497,27 +287,6 @@ HASH_KEY_MAP BLACK_ROOK_LOCK{{
     {400811665, 913290966, -85044038, 1972276679, 457439689, 16537810, 1119347526, 1978754496, 1277092857, 195690950},
 }};
 
-HASH_KEY_MAP BLACK_CANNON_KEY{{
-    {-1731172071, -1132693947, -1277283507, -636624969, 849687134, 294021211, 1368164472, -741298427, -985558520,
-     1328793031},
-    {-1287052819, -1418045978, 1362272501, -1925222539, 1037248380, -378410617, 596345655, 900065967, -96005276,
-     -487942907},
-    {437084152, -1077704366, 755038443, -109703697, -241288432, -1597223554, 136883538, 827764355, -1207033814,
-     864118838},
-    {-1118377523, -1791653147, -1512006938, -1166402882, 90336061, -1567817248, 1588688223, 1780271823, -1494953422,
-     352415176},
-    {-1965419706, 84836417, 875334693, 110153192, -960816340, -1001044028, -508136058, 152499087, 1115890979,
-     532778088},
-    {1399694382, 1410070117, -255648577, 553656042, -2122093857, -1671801379, -140773623, 653642341, -1970198106,
-     886841832},
-    {-78923613, -1076122131, 1223500066, -1600141750, -122614627, -1442327799, 1666148926, -475586923, 1303848803,
-     -1549678253},
-    {-336463367, -902266731, -973948710, -1408353444, -1974999518, 1460739896, 380375833, 1518992085, 1047456289,
-     -1305686072},
-    {-1319608794, -1631419536, 1119210340, 1924119797, -176318088, -901594947, -186680105, 2082510820, 558053140,
-     1079376776},
-}};
-
 HASH_KEY_MAP BLACK_CANNON_LOCK{{
     {1266673266, -1108141200, 1629046624, -1747582573, 821270297, 830707387, -673255867, -1127495543, -42868710,
      -584723285},
@@ -538,27 +307,6 @@ HASH_KEY_MAP BLACK_CANNON_LOCK{{
      1263908537},
 }};
 
-HASH_KEY_MAP BLACK_PAWN_KEY{{
-    {1618941718, -1616112433, -799682740, -1296926854, -1723461532, -17326023, 241533940, -1510592374, 238693009,
-     23110560},
-    {-295169818, -648842121, 2026551445, -656009887, 1924813128, 1813194861, 1923108619, -1076300115, -1529837360,
-     66071263},
-    {82201911, 556834478, -1425938666, 660148675, 1834040120, -1028200855, 1913023173, 905588605, 1698605787,
-     -79779844},
-    {-123434161, 1319380520, -1038101600, 198475719, -1255965450, -43316468, 1602609855, 267944148, -121390495,
-     1506843836},
-    {-676697917, -1014780025, 92041544, -629588308, 1109537862, 1424265507, 50975650, -1693836957, 144036947,
-     935364398},
-    {320350697, -998127468, -953230903, 1243047413, -270231977, -256520815, 84442556, -533682763, 1780659671,
-     906921611},
-    {687185918, -992060830, -418999518, -1997062061, 1473608722, 1896534616, 1496054804, -805172416, -292259992,
-     1327811771},
-    {2063911212, 839543101, -1693493083, 2040655642, -1781424328, 214698916, 1377569522, 1800801966, 69105053,
-     -1122737466},
-    {-1967349295, -553754370, -45684749, 436015511, 203734321, 715613876, -1101834933, -263379770, 110431457,
-     1281075415},
-}};
-
 HASH_KEY_MAP BLACK_PAWN_LOCK{{
     {854231263, -1870625230, 1404669615, 1241556553, -707909817, -125236490, -118772239, 1393099255, 1631209505,
      796481955},
@@ -580,18 +328,11 @@ HASH_KEY_MAP BLACK_PAWN_LOCK{{
      1167917115},
 }};
 
-std::map<PIECEID, HASH_KEY_MAP> HASHKEYS{
-    {R_KING, RED_KING_KEY},       {R_GUARD, RED_GUARD_KEY},     {R_BISHOP, RED_BISHOP_KEY},
-    {R_KNIGHT, RED_KNIGHT_KEY},   {R_ROOK, RED_ROOK_KEY},       {R_CANNON, RED_CANNON_KEY},
-    {R_PAWN, RED_PAWN_KEY},       {B_KING, BLACK_KING_KEY},     {B_GUARD, BLACK_GUARD_KEY},
-    {B_BISHOP, BLACK_BISHOP_KEY}, {B_KNIGHT, BLACK_KNIGHT_KEY}, {B_ROOK, BLACK_ROOK_KEY},
-    {B_CANNON, BLACK_CANNON_KEY}, {B_PAWN, BLACK_PAWN_KEY},
+// 按 pieceid + 7 索引
+const std::array<HASH_KEY_MAP*, 15> HASHLOCKS{
+    &BLACK_PAWN_LOCK, &BLACK_CANNON_LOCK, &BLACK_ROOK_LOCK, &BLACK_KNIGHT_LOCK, &BLACK_BISHOP_LOCK,
+    &BLACK_GUARD_LOCK, &BLACK_KING_LOCK,  nullptr,          &RED_KING_LOCK,     &RED_GUARD_LOCK,
+    &RED_BISHOP_LOCK,  &RED_KNIGHT_LOCK,  &RED_ROOK_LOCK,   &RED_CANNON_LOCK,   &RED_PAWN_LOCK,
 };
 
-std::map<PIECEID, HASH_KEY_MAP> HASHLOCKS{
-    {R_KING, RED_KING_LOCK},       {R_GUARD, RED_GUARD_LOCK},     {R_BISHOP, RED_BISHOP_LOCK},
-    {R_KNIGHT, RED_KNIGHT_LOCK},   {R_ROOK, RED_ROOK_LOCK},       {R_CANNON, RED_CANNON_LOCK},
-    {R_PAWN, RED_PAWN_LOCK},       {B_KING, BLACK_KING_LOCK},     {B_GUARD, BLACK_GUARD_LOCK},
-    {B_BISHOP, BLACK_BISHOP_LOCK}, {B_KNIGHT, BLACK_KNIGHT_LOCK}, {B_ROOK, BLACK_ROOK_LOCK},
-    {B_CANNON, BLACK_CANNON_LOCK}, {B_PAWN, BLACK_PAWN_LOCK},
-};
+inline int32 hashLockOf(PIECEID pid, int x, int y) { return (*HASHLOCKS[size_t(pid + 7)])[size_t(x)][size_t(y)]; }
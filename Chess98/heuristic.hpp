@@ -8,31 +8,46 @@ class HistoryTable
 public:
     HistoryTable() = default;
     void reset() { this->historyTable = std::make_unique<HISTORY_TABLE>(); }
+    // 新的一步棋开始时衰减而不是清空, 保留上一步搜索的走法排序经验
+    void decay()
+    {
+        for (auto& table : *this->historyTable)
+        {
+            for (auto& line : table)
+            {
+                for (int& vl : line)
+                {
+                    vl /= 2;
+                }
+            }
+        }
+    }
 
 protected:
     using HISTORY_TABLE = std::array<std::array<std::array<int, 90>, 90>, 2>;
     std::unique_ptr<HISTORY_TABLE> historyTable = std::make_unique<HISTORY_TABLE>();
 
 public:
-    void add(Move move, int depth)
+    void add(const Board& board, Move move, int depth)
+    {
+        const int team = board.team == RED ? 0 : 1;
+        this->historyTable->at(team)[move.startpos()][move.endpos()] += depth * depth;
+    }
+
+    int get(const Board& board, Move move) const
     {
-        const int pos1 = 10 * move.x1 + move.y1;
-        const int pos2 = 10 * move.x2 + move.y2;
-        const int team = move.attacker.team == RED ? 0 : 1;
-        this->historyTable->at(team)[pos1][pos2] += depth * depth;
+        const int team = board.team == RED ? 0 : 1;
+        return this->historyTable->at(team)[move.startpos()][move.endpos()];
     }
 
-    void sort(MOVES& moves) const
+    void sort(const Board& board, MoveList& moves) const
     {
-        for (Move& move : moves)
+        const int team = board.team == RED ? 0 : 1;
+        for (size_t i = 0; i < moves.size(); i++)
         {
-            const int pos1 = 10 * move.x1 + move.y1;
-            const int pos2 = 10 * move.x2 + move.y2;
-            const int team = move.attacker.team == RED ? 0 : 1;
-            move.moveType = HISTORY;
-            move.val = this->historyTable->at(team)[pos1][pos2];
+            moves.val(i) = this->historyTable->at(team)[moves[i].startpos()][moves[i].endpos()];
         }
-        std::sort(moves.begin(), moves.end(), [](Move& m1, Move& m2) -> bool { return m1.val > m2.val; });
+        moves.sortByVal();
     }
 };
 
@@ -55,9 +70,9 @@ public:
         moves[0] = move;
     }
 
-    MOVES get(Board& board) const
+    void get(Board& board, MoveList& results) const
     {
-        MOVES results{};
+        results.clear();
         for (const Move& move : this->killerMoves->at(board.distance))
         {
             if (board.isValidMoveInSituation(move))
@@ -65,128 +80,585 @@ public:
                 results.emplace_back(move);
             }
         }
-        return results;
     }
 };
 
-// 置换表启发
-class Tt
+// 主要变例
+// 三角形表, 第 ply 行保存从该层开始的最佳着法序列, 子节点的序列在回溯时拷贝到父节点
+// 上一次迭代的主要变例保留下来, 下一次迭代在各层先搜索
+class PvTable
 {
 public:
-    Tt(uint64 hashLevel = 16)
+    PvTable() = default;
+    void reset()
     {
-        this->hashSize = 1 << hashLevel;
-        this->hashMask = (1 << hashLevel) - 1;
-        this->items.resize(1ULL << hashLevel);
+        this->length.fill(0);
+        this->previousLine.clear();
     }
-    void reset()
+
+protected:
+    using PV_TABLE = std::array<std::array<Move, ENGINE_MAX_DEPTH>, ENGINE_MAX_DEPTH>;
+    std::unique_ptr<PV_TABLE> table = std::make_unique<PV_TABLE>();
+    std::array<int, ENGINE_MAX_DEPTH + 1> length{};
+    MOVES previousLine{};
+
+public:
+    void clear(int ply)
     {
-        for (TransItem& item : this->items)
+        if (ply < ENGINE_MAX_DEPTH)
         {
-            item = TransItem{};
+            this->length[ply] = ply;
         }
     }
 
-protected:
-    using HASH_ITEMS = std::vector<TransItem>;
-    HASH_ITEMS items{};
-    int hashMask = 0;
-    int hashSize = 0;
+    void update(int ply, Move move)
+    {
+        if (ply >= ENGINE_MAX_DEPTH - 1)
+        {
+            return;
+        }
+        std::array<Move, ENGINE_MAX_DEPTH>& line = this->table->at(ply);
+        const std::array<Move, ENGINE_MAX_DEPTH>& childLine = this->table->at(ply + 1);
+        line[ply] = move;
+        const int childLength = std::max(this->length[ply + 1], ply + 1);
+        for (int i = ply + 1; i < childLength; i++)
+        {
+            line[i] = childLine[i];
+        }
+        this->length[ply] = childLength;
+    }
 
-protected:
-    int vlAdjust(int vl, int nDistance) const { return vl + (vl <= -BAN ? nDistance : (vl >= BAN ? -nDistance : 0)); }
+    MOVES line() const { return MOVES(this->table->at(0).begin(), this->table->at(0).begin() + this->length[0]); }
+
+    // 一次迭代完成后保存, 供下一次迭代使用
+    void save() { this->previousLine = this->line(); }
+    // 多主要变例时, 搜索每条变例前换上该变例在上一次迭代的结果
+    void restore(const MOVES& line) { this->previousLine = line; }
+
+    Move previous(int ply) const { return ply < int(this->previousLine.size()) ? this->previousLine[ply] : Move{}; }
+};
 
+// 置换表启发
+class Tt
+{
 public:
-    void set(Board& board, Move goodMove, int vl, NODE_TYPE type, int depth)
+    Tt(uint64 hashLevel = 16) { this->allocate((1ULL << hashLevel) * sizeof(TransItem)); }
+    ~Tt() { this->release(); }
+    Tt(const Tt&) = delete;
+    Tt& operator=(const Tt&) = delete;
+    void resize(int hashMb)
+    {
+        this->release();
+        this->allocate(uint64(std::max<int>(hashMb, 1)) << 20);
+        this->reset();
+    }
+    void reset()
     {
-        const int pos = static_cast<uint32_t>(board.hashKey) & static_cast<uint32_t>(this->hashMask);
-        TransItem& t = this->items[pos];
-        if (t.hashLock == 0)
+        // 大表按线程分块并行清零
+        const uint64 bytes = this->bucketCount * sizeof(TransBucket);
+        const uint64 threadCount = bytes < (16ULL << 20) ? 1 : std::max<uint64>(1, std::thread::hardware_concurrency());
+        const uint64 chunk = (this->bucketCount + threadCount - 1) / threadCount;
+        std::vector<std::thread> workers{};
+        for (uint64 i = 0; i < threadCount; i++)
         {
-            t.hashLock = board.hashLock;
-            if (type == EXACT_TYPE)
+            const uint64 begin = i * chunk;
+            const uint64 count = std::min<uint64>(chunk, this->bucketCount - std::min<uint64>(begin, this->bucketCount));
+            if (count == 0)
             {
-                t.exactDepth = depth;
-                t.vlExact = vl;
-                t.exactMove = goodMove;
+                break;
             }
-            else if (type == BETA_TYPE)
+            TransBucket* start = this->buckets + begin;
+            auto clear = [start, count]() { std::memset(static_cast<void*>(start), 0, count * sizeof(TransBucket)); };
+            if (i + 1 == threadCount)
             {
-                t.betaDepth = depth;
-                t.vlBeta = vl;
-                t.betaMove = goodMove;
+                clear();
             }
-            else if (type == ALPHA_TYPE)
+            else
             {
-                t.alphaDepth = depth;
-                t.vlAlpha = vl;
-                t.alphaMove = goodMove;
+                workers.emplace_back(clear);
             }
         }
-        else if (t.hashLock == board.hashLock)
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+    int sizeMb() const { return int((this->bucketCount * sizeof(TransBucket)) >> 20); }
+    // 抽样前1000个表项, 返回本次搜索写入的表项所占的千分比
+    int hashfull() const
+    {
+        const uint64 sampleBuckets = std::min<uint64>(1000 / BUCKET_SIZE, this->bucketCount);
+        int used = 0;
+        for (uint64 i = 0; i < sampleBuckets; i++)
         {
-            if (type == EXACT_TYPE && depth > t.exactDepth)
+            for (const TransItem& item : this->buckets[i].items)
             {
-                t.exactDepth = depth;
-                t.vlExact = vl;
-                t.exactMove = goodMove;
+                const uint64 data = item.data.load(std::memory_order_relaxed);
+                if (data != 0 && unpackData(data).generation == this->generation)
+                {
+                    used++;
+                }
             }
-            else if (type == BETA_TYPE && ((depth > t.betaDepth) || (depth == t.betaDepth && vl > t.vlBeta)))
+        }
+        return int(uint64(used) * 1000 / std::max<uint64>(sampleBuckets * BUCKET_SIZE, 1));
+    }
+    // 每次搜索开始时推进世代, 旧搜索的表项保留下来但优先被替换
+    void newSearch() { this->generation = (this->generation + 1) & GENERATION_MASK; }
+
+protected:
+    static const int BUCKET_SIZE = 4;
+    struct alignas(64) TransBucket
+    {
+        std::array<TransItem, BUCKET_SIZE> items{};
+    };
+    TransBucket* buckets = nullptr;
+    uint64 bucketMask = 0;
+    uint64 bucketCount = 0;
+    uint64 allocatedBytes = 0;
+    bool mapped = false;
+    int generation = 0;
+    static const int GENERATION_MASK = 63;
+
+protected:
+    void allocate(uint64 bytes)
+    {
+        // 桶数取不超过给定内存的2的幂
+        uint64 count = 1;
+        while (count * 2 * sizeof(TransBucket) <= bytes)
+        {
+            count *= 2;
+        }
+        this->bucketCount = count;
+        this->bucketMask = count - 1;
+        this->allocatedBytes = count * sizeof(TransBucket);
+        void* memory = nullptr;
+#ifdef __unix__
+        // 尝试以2MB大页映射, 减少TLB缺失
+        const uint64 HUGE_PAGE = 2ULL << 20;
+        if (this->allocatedBytes >= HUGE_PAGE)
+        {
+            void* p = mmap(nullptr, this->allocatedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p != MAP_FAILED)
             {
-                t.betaDepth = depth;
-                t.vlBeta = vl;
-                t.betaMove = goodMove;
+#ifdef MADV_HUGEPAGE
+                madvise(p, this->allocatedBytes, MADV_HUGEPAGE);
+#endif
+                memory = p;
+                this->mapped = true;
             }
-            else if (type == ALPHA_TYPE && ((depth > t.alphaDepth) || (depth == t.alphaDepth && vl < t.vlAlpha)))
+        }
+#endif
+        if (memory == nullptr)
+        {
+            memory = ::operator new(this->allocatedBytes, std::align_val_t{alignof(TransBucket)});
+            std::memset(memory, 0, this->allocatedBytes);
+            this->mapped = false;
+        }
+        this->buckets = static_cast<TransBucket*>(memory);
+    }
+    void release()
+    {
+        if (this->buckets == nullptr)
+        {
+            return;
+        }
+#ifdef __unix__
+        if (this->mapped)
+        {
+            munmap(this->buckets, this->allocatedBytes);
+        }
+        else
+#endif
+        {
+            ::operator delete(this->buckets, std::align_val_t{alignof(TransBucket)});
+        }
+        this->buckets = nullptr;
+        this->bucketCount = 0;
+        this->bucketMask = 0;
+    }
+
+protected:
+    // data 布局: 着法(16位) | 分值(32位) | 深度(8位) | 节点类型(2位) | 世代(6位)
+    struct TransData
+    {
+        uint16_t move = 0;
+        int32 vl = 0;
+        int depth = 0;
+        NODE_TYPE type = NONE_TYPE;
+        int generation = 0;
+    };
+    static uint64 packData(const TransData& d)
+    {
+        uint64 result = d.move;
+        result |= uint64(uint32(d.vl)) << 16;
+        result |= uint64(std::min<int>(std::max<int>(d.depth, 0), 255)) << 48;
+        result |= uint64(d.type & 3) << 56;
+        result |= uint64(d.generation & GENERATION_MASK) << 58;
+        return result;
+    }
+    static TransData unpackData(uint64 data)
+    {
+        TransData d{};
+        d.move = uint16_t(data & 0xFFFF);
+        d.vl = int32(uint32((data >> 16) & 0xFFFFFFFF));
+        d.depth = int((data >> 48) & 0xFF);
+        d.type = NODE_TYPE((data >> 56) & 3);
+        d.generation = int((data >> 58) & GENERATION_MASK);
+        return d;
+    }
+    // 着法编码为 起点 << 7 | 终点, 0 表示没有着法
+    static uint16_t encodeMove(const Move& move) { return move.id() == -1 ? 0 : uint16_t((move.startpos() << 7) | move.endpos()); }
+    static Move decodeMove(uint16_t code)
+    {
+        const int startpos = code >> 7;
+        const int endpos = code & 127;
+        return Move{startpos / 10, startpos % 10, endpos / 10, endpos % 10};
+    }
+    static uint64 fullKey(const Board& board) { return board.hashKey; }
+    TransBucket& bucketOf(const Board& board) const { return this->buckets[board.hashKey & this->bucketMask]; }
+    static bool probe(const TransItem& item, uint64 key, TransData& d)
+    {
+        const uint64 data = item.data.load(std::memory_order_relaxed);
+        const uint64 keyXorData = item.keyXorData.load(std::memory_order_relaxed);
+        if ((keyXorData ^ data) != key || data == 0)
+        {
+            return false;
+        }
+        d = unpackData(data);
+        return d.type != NONE_TYPE;
+    }
+    static void store(TransItem& item, uint64 key, const TransData& d)
+    {
+        const uint64 data = packData(d);
+        item.keyXorData.store(key ^ data, std::memory_order_relaxed);
+        item.data.store(data, std::memory_order_relaxed);
+    }
+
+protected:
+    int vlAdjust(int vl, int nDistance) const { return vl + (vl <= -BAN ? nDistance : (vl >= BAN ? -nDistance : 0)); }
+
+public:
+    void set(Board& board, Move goodMove, int vl, NODE_TYPE type, int depth)
+    {
+        const uint64 key = fullKey(board);
+        TransBucket& bucket = this->bucketOf(board);
+        TransItem* replace = &bucket.items[0];
+        int replaceWorth = INF;
+        for (TransItem& item : bucket.items)
+        {
+            TransData d{};
+            if (probe(item, key, d))
             {
-                t.alphaDepth = depth;
-                t.vlAlpha = vl;
-                t.alphaMove = goodMove;
+                // 同一局面: 更深、精确或来自旧搜索的结果被覆盖, 否则保留原结果
+                if (type == EXACT_TYPE || depth >= d.depth || d.generation != this->generation)
+                {
+                    TransData nd{encodeMove(goodMove), vl, depth, type, this->generation};
+                    if (nd.move == 0)
+                    {
+                        nd.move = d.move;
+                    }
+                    store(item, key, nd);
+                }
+                return;
+            }
+            // 替换价值最低的表项: 深度越浅、世代越旧越先被替换, 空表项最先被替换
+            const uint64 data = item.data.load(std::memory_order_relaxed);
+            int worth = -INF;
+            if (data != 0)
+            {
+                const TransData old = unpackData(data);
+                worth = old.depth - 4 * ((this->generation - old.generation) & GENERATION_MASK);
+            }
+            if (worth < replaceWorth)
+            {
+                replaceWorth = worth;
+                replace = &item;
             }
         }
+        store(*replace, key, TransData{encodeMove(goodMove), vl, depth, type, this->generation});
     }
 
     int getVl(Board& board, int vlApha, int vlBeta, int depth) const
     {
-        const int pos = static_cast<uint32_t>(board.hashKey) & static_cast<uint32_t>(this->hashMask);
-        const TransItem& t = this->items[pos];
-        if (t.hashLock == board.hashLock)
+        const uint64 key = fullKey(board);
+        for (const TransItem& item : this->bucketOf(board).items)
         {
-            if (t.exactDepth >= depth)
+            TransData d{};
+            if (probe(item, key, d))
             {
-                return vlAdjust(t.vlExact, board.distance);
+                if (d.depth >= depth)
+                {
+                    if (d.type == EXACT_TYPE)
+                    {
+                        return vlAdjust(d.vl, board.distance);
+                    }
+                    else if (d.type == BETA_TYPE && d.vl >= vlBeta)
+                    {
+                        return d.vl;
+                    }
+                    else if (d.type == ALPHA_TYPE && d.vl <= vlApha)
+                    {
+                        return d.vl;
+                    }
+                }
+                break;
             }
-            else if (t.betaDepth >= depth && t.vlBeta >= vlBeta)
+        }
+        return -INF;
+    }
+
+    Move getMove(Board& board) const
+    {
+        const uint64 key = fullKey(board);
+        for (const TransItem& item : this->bucketOf(board).items)
+        {
+            TransData d{};
+            if (probe(item, key, d))
             {
-                return t.vlBeta;
+                if (d.move != 0)
+                {
+                    Move move = decodeMove(d.move);
+                    if (board.isValidMoveInSituation(move))
+                    {
+                        return move;
+                    }
+                }
+                break;
             }
-            else if (t.alphaDepth >= depth && t.vlAlpha <= vlApha)
+        }
+        return Move{};
+    }
+};
+
+// 分阶段着法生成器
+// 依次给出 置换表着法 -> 不亏子的吃子着法(MVV/LVA) -> 杀手着法 -> 不吃子着法(历史表) -> 亏子的吃子着法
+// 前面的着法产生截断时, 后面阶段的着法不再生成, 只要吃子着法时亏子的吃子直接剪掉
+// 被将军时只生成应将着法, 吃子在前, 其余按历史表排序
+class MovePicker
+{
+public:
+    MovePicker(Board& board, const HistoryTable& history, const KillerTable& killer, Move hashMove, bool checked, bool captureOnly = false)
+        : board(board), history(history), killer(killer), hashMove(hashMove), checked(checked), captureOnly(captureOnly)
+    {
+    }
+    MovePicker(const MovePicker&) = delete;
+    MovePicker& operator=(const MovePicker&) = delete;
+
+protected:
+    static const int HASH_STAGE = 0;
+    static const int CAPTURE_GEN_STAGE = 1;
+    static const int CAPTURE_STAGE = 2;
+    static const int KILLER_GEN_STAGE = 3;
+    static const int KILLER_STAGE = 4;
+    static const int QUIET_GEN_STAGE = 5;
+    static const int QUIET_STAGE = 6;
+    static const int BAD_CAPTURE_STAGE = 7;
+    static const int EVASION_GEN_STAGE = 8;
+    static const int EVASION_STAGE = 9;
+    static const int DONE_STAGE = 10;
+    static const int EVASION_CAPTURE_BONUS = 1 << 30;
+
+    Board& board;
+    const HistoryTable& history;
+    const KillerTable& killer;
+    Move hashMove{};
+    bool checked = false;
+    bool captureOnly = false;
+    int stage = HASH_STAGE;
+    MoveList moves;
+    size_t index = 0;
+    std::array<Move, 2> killers{};
+    size_t killerCount = 0;
+    MoveList badCaptures;
+
+protected:
+    // 被吃子价值优先, 相同时攻击子价值小的优先
+    // 不同子力的价值至少相差50, 乘32后大于攻击子价值的取值范围(将按1000计)
+    static int mvvLva(PIECEID captured, PIECEID attacker)
+    {
+        return (SEE_VALUE[abs(captured)] << 5) - std::min<int>(SEE_VALUE[abs(attacker)], 1000);
+    }
+    // 被吃子不比攻击子便宜时一定不亏, 否则用静态交换评估判断
+    bool isLosingCapture(Move move)
+    {
+        const PIECEID captured = this->board.pieceidOn(move.x2, move.y2);
+        const PIECEID attacker = this->board.pieceidOn(move.x1, move.y1);
+        if (SEE_VALUE[abs(captured)] >= SEE_VALUE[abs(attacker)])
+        {
+            return false;
+        }
+        return this->board.see(move) < 0;
+    }
+    bool isKiller(Move move) const
+    {
+        for (size_t i = 0; i < this->killerCount; i++)
+        {
+            if (this->killers[i] == move)
             {
-                return t.vlAlpha;
+                return true;
             }
         }
-        return -INF;
+        return false;
     }
 
-    Move getMove(Board& board) const
+public:
+    // 返回下一个合法着法, 没有着法时返回空着法
+    Move next()
     {
-        const int pos = static_cast<uint32_t>(board.hashKey) & static_cast<uint32_t>(this->hashMask);
-        const TransItem& t = this->items[pos];
-        if (t.hashLock == board.hashLock)
+        while (true)
         {
-            if (board.isValidMoveInSituation(t.exactMove))
+            switch (this->stage)
             {
-                return t.exactMove;
+            case HASH_STAGE:
+                this->stage = this->checked ? EVASION_GEN_STAGE : CAPTURE_GEN_STAGE;
+                // 置换表着法已经完整校验过合法性
+                if (this->hashMove.id() != -1)
+                {
+                    return this->hashMove;
+                }
+                break;
+            case CAPTURE_GEN_STAGE:
+            {
+                MovesGen::getPseudoCaptureMoves(this->board, this->moves);
+                size_t count = 0;
+                for (size_t i = 0; i < this->moves.size(); i++)
+                {
+                    const Move move = this->moves[i];
+                    if (move == this->hashMove)
+                    {
+                        continue;
+                    }
+                    this->moves[count] = move;
+                    this->moves.val(count) = mvvLva(this->board.pieceidOn(move.x2, move.y2), this->board.pieceidOn(move.x1, move.y1));
+                    count++;
+                }
+                this->moves.resize(count);
+                this->index = 0;
+                this->stage = CAPTURE_STAGE;
+                break;
             }
-            else if (board.isValidMoveInSituation(t.betaMove))
+            case CAPTURE_STAGE:
+                while (this->index < this->moves.size())
+                {
+                    this->moves.selectBest(this->index);
+                    const Move move = this->moves[this->index++];
+                    if (!this->checked && this->isLosingCapture(move))
+                    {
+                        if (!this->captureOnly)
+                        {
+                            this->badCaptures.emplace_back(move);
+                        }
+                        continue;
+                    }
+                    if (this->board.isLegalMove(move, this->checked))
+                    {
+                        return move;
+                    }
+                }
+                this->stage = this->captureOnly ? DONE_STAGE : KILLER_GEN_STAGE;
+                break;
+            case KILLER_GEN_STAGE:
+                // 杀手着法已经完整校验过合法性, 吃子着法已经在前一阶段给出
+                this->killer.get(this->board, this->moves);
+                for (const Move& move : this->moves)
+                {
+                    if (move != this->hashMove && this->board.pieceidOn(move.x2, move.y2) == EMPTY_PIECEID)
+                    {
+                        this->killers[this->killerCount++] = move;
+                    }
+                }
+                this->index = 0;
+                this->stage = KILLER_STAGE;
+                break;
+            case KILLER_STAGE:
+                if (this->index < this->killerCount)
+                {
+                    return this->killers[this->index++];
+                }
+                this->stage = QUIET_GEN_STAGE;
+                break;
+            case QUIET_GEN_STAGE:
             {
-                return t.betaMove;
+                MovesGen::getPseudoMoves(this->board, this->moves);
+                size_t count = 0;
+                for (size_t i = 0; i < this->moves.size(); i++)
+                {
+                    const Move move = this->moves[i];
+                    if (this->board.pieceidOn(move.x2, move.y2) != EMPTY_PIECEID || move == this->hashMove || this->isKiller(move))
+                    {
+                        continue;
+                    }
+                    this->moves[count] = move;
+                    this->moves.val(count) = this->history.get(this->board, move);
+                    count++;
+                }
+                this->moves.resize(count);
+                this->index = 0;
+                this->stage = QUIET_STAGE;
+                break;
             }
-            else if (board.isValidMoveInSituation(t.alphaMove))
+            case QUIET_STAGE:
+                while (this->index < this->moves.size())
+                {
+                    this->moves.selectBest(this->index);
+                    const Move move = this->moves[this->index++];
+                    if (this->board.isLegalMove(move, this->checked))
+                    {
+                        return move;
+                    }
+                }
+                this->index = 0;
+                this->stage = BAD_CAPTURE_STAGE;
+                break;
+            case BAD_CAPTURE_STAGE:
+                while (this->index < this->badCaptures.size())
+                {
+                    const Move move = this->badCaptures[this->index++];
+                    if (this->board.isLegalMove(move, this->checked))
+                    {
+                        return move;
+                    }
+                }
+                this->stage = DONE_STAGE;
+                break;
+            case EVASION_GEN_STAGE:
             {
-                return t.alphaMove;
+                MovesGen::getPseudoEvasions(this->board, this->moves);
+                size_t count = 0;
+                for (size_t i = 0; i < this->moves.size(); i++)
+                {
+                    const Move move = this->moves[i];
+                    if (move == this->hashMove)
+                    {
+                        continue;
+                    }
+                    const PIECEID captured = this->board.pieceidOn(move.x2, move.y2);
+                    this->moves[count] = move;
+                    this->moves.val(count) = captured != EMPTY_PIECEID
+                                                 ? EVASION_CAPTURE_BONUS + mvvLva(captured, this->board.pieceidOn(move.x1, move.y1))
+                                                 : std::min<int>(this->history.get(this->board, move), EVASION_CAPTURE_BONUS - 1);
+                    count++;
+                }
+                this->moves.resize(count);
+                this->index = 0;
+                this->stage = EVASION_STAGE;
+                break;
+            }
+            case EVASION_STAGE:
+                while (this->index < this->moves.size())
+                {
+                    this->moves.selectBest(this->index);
+                    const Move move = this->moves[this->index++];
+                    if (this->board.isLegalMove(move, true))
+                    {
+                        return move;
+                    }
+                }
+                this->stage = DONE_STAGE;
+                break;
+            default:
+                return Move{};
             }
         }
-        return Move{};
     }
 };
@@ -19,8 +19,29 @@ void validateUCCI()
     }
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    // Chess98 bench [depth] [threads] [hashMB]
+    if (argc >= 2 && std::string(argv[1]) == "bench")
+    {
+        // 参数必须是正整数, 超过上限的按上限处理
+        std::vector<int> args{7, 1, 16};
+        const std::vector<int64_t> maxArgs{ENGINE_MAX_DEPTH - 1, MAX_THREADS, MAX_HASH_MB};
+        for (int i = 2; i < argc; i++)
+        {
+            int64_t value = 0;
+            if (size_t(i - 2) >= args.size() || !parseInt(argv[i], value) || value <= 0)
+            {
+                std::cout << "usage: Chess98 bench [depth 1-" << maxArgs[0] << "] [threads 1-" << maxArgs[1] << "] [hashMB 1-"
+                          << maxArgs[2] << "]" << std::endl;
+                return 2;
+            }
+            args[i - 2] = int(std::min<int64_t>(value, maxArgs[i - 2]));
+        }
+        Bench::run(args[0], args[1], args[2]);
+        return 0;
+    }
+
     setRealtimePriority();
     std::thread v(validateUCCI);
     v.detach();
@@ -4,912 +4,336 @@
 class MovesGen
 {
 public:
-    static MOVES king(TEAM team, Board& board, int x, int y);
-    static MOVES guard(TEAM team, Board& board, int x, int y);
-    static MOVES bishop(TEAM team, Board& board, int x, int y);
-    static MOVES knight(TEAM team, Board& board, int x, int y);
-    static MOVES rook(TEAM team, Board& board, int x, int y);
-    static MOVES cannon(TEAM team, Board& board, int x, int y);
-    static MOVES pawn(TEAM team, Board& board, int x, int y);
-    static MOVES generateMovesOn(Board& board, int x, int y);
-    static MOVES getMoves(Board& board);
-
-    static MOVES kingCapture(TEAM team, Board& board, int x, int y);
-    static MOVES guardCapture(TEAM team, Board& board, int x, int y);
-    static MOVES bishopCapture(TEAM team, Board& board, int x, int y);
-    static MOVES knightCapture(TEAM team, Board& board, int x, int y);
-    static MOVES rookCapture(TEAM team, Board& board, int x, int y);
-    static MOVES cannonCapture(TEAM team, Board& board, int x, int y);
-    static MOVES pawnCapture(TEAM team, Board& board, int x, int y);
-    static MOVES generateCaptureMovesOn(Board& board, int x, int y);
-    static MOVES getCaptureMoves(Board& board);
+    static void king(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void guard(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void bishop(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void knight(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void rook(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void cannon(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void pawn(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void generateMovesOn(Board& board, int x, int y, MoveList& result);
+    static void getMoves(Board& board, MoveList& result);
+    static void getPseudoMoves(Board& board, MoveList& result);
+
+    static void kingCapture(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void guardCapture(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void bishopCapture(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void knightCapture(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void rookCapture(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void cannonCapture(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void pawnCapture(TEAM team, Board& board, int x, int y, MoveList& result);
+    static void generateCaptureMovesOn(Board& board, int x, int y, MoveList& result);
+    static void getCaptureMoves(Board& board, MoveList& result);
+    static void getPseudoCaptureMoves(Board& board, MoveList& result);
+    static void getPseudoEvasions(Board& board, MoveList& result);
 
 protected:
-    static MOVES facedKings(const Board& board);
+    static bool facedKings(const Board& board, MoveList& result);
+    static void generatePiecesOf(Board& board, PIECEID pieceid, MoveList& result, bool captureOnly);
+    static void removeIllegalMoves(Board& board, MoveList& moves);
+    static void addTargets(int x, int y, Bitboard90 targets, MoveList& result);
+    static void keepTargets(MoveList& moves, size_t from, Bitboard90 targets, bool inside);
 };
 
-MOVES MovesGen::king(TEAM team, Board& board, int x, int y)
+void MovesGen::king(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result;
-
-    // 横坐标应当在3, 5之间, 纵坐标的话, 红方在0, 2之间, 黑方在7, 9之间
-    const int left = x - 1;
-    const int right = x + 1;
-    const int up = y + 1;
-    const int down = y - 1;
-
-    if (left >= 3 && board.teamOn(left, y) != team)
-    {
-        result.emplace_back(Move{x, y, left, y});
-    }
-    if (right <= 5 && board.teamOn(right, y) != team)
-    {
-        result.emplace_back(Move{x, y, right, y});
-    }
-    if (team == RED)
-    {
-        if (up <= 2 && board.teamOn(x, up) != team)
-        {
-            result.emplace_back(Move{x, y, x, up});
-        }
-        if (down >= 0 && board.teamOn(x, down) != team)
-        {
-            result.emplace_back(Move{x, y, x, down});
-        }
-    }
-    else
-    {
-        if (up <= 9 && board.teamOn(x, up) != team)
-        {
-            result.emplace_back(Move{x, y, x, up});
-        }
-        if (down >= 7 && board.teamOn(x, down) != team)
-        {
-            result.emplace_back(Move{x, y, x, down});
-        }
-    }
-
-    return result;
+    // 九宫内上下左右一格
+    const Bitboard90 targets = board.bitboard->getTables().kingSteps[AttackTables::teamIndex(team)][x * 10 + y];
+    MovesGen::addTargets(x, y, targets & ~board.bitboard->getTeam(team), result);
 }
 
-MOVES MovesGen::guard(TEAM team, Board& board, int x, int y)
+void MovesGen::guard(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    // 横坐标也应在3, 5之间, 纵坐标的话, 红方在0, 2之间, 黑方在7, 9之间
-    const int left = x - 1;
-    const int right = x + 1;
-    const int up = y + 1;
-    const int down = y - 1;
-    if (left >= 3)
-    {
-        if (team == RED)
-        {
-            if (board.teamOn(left, up) != team && up <= 2)
-            {
-                result.emplace_back(Move{x, y, left, up});
-            }
-            if (board.teamOn(left, down) != team && down >= 0)
-            {
-                result.emplace_back(Move{x, y, left, down});
-            }
-        }
-        else
-        {
-            if (board.teamOn(left, up) != team && up <= 9)
-            {
-                result.emplace_back(Move{x, y, left, up});
-            }
-            if (board.teamOn(left, down) != team && down >= 7)
-            {
-                result.emplace_back(Move{x, y, left, down});
-            }
-        }
-    }
-    if (right <= 5)
-    {
-        if (team == RED)
-        {
-            if (board.teamOn(right, up) != team && up <= 2)
-            {
-                result.emplace_back(Move{x, y, right, up});
-            }
-            if (board.teamOn(right, down) != team && down >= 0)
-            {
-                result.emplace_back(Move{x, y, right, down});
-            }
-        }
-        else
-        {
-            if (board.teamOn(right, up) != team && up <= 9)
-            {
-                result.emplace_back(Move{x, y, right, up});
-            }
-            if (board.teamOn(right, down) != team && down >= 7)
-            {
-                result.emplace_back(Move{x, y, right, down});
-            }
-        }
-    }
-
-    return result;
+    // 九宫内斜走一格
+    const Bitboard90 targets = board.bitboard->getTables().guardSteps[AttackTables::teamIndex(team)][x * 10 + y];
+    MovesGen::addTargets(x, y, targets & ~board.bitboard->getTeam(team), result);
 }
 
-MOVES MovesGen::bishop(TEAM team, Board& board, int x, int y)
+void MovesGen::bishop(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    // 横坐标应在0, 9之间, 纵坐标的话, 红方在0, 4之间, 黑方在5, 9之间
-    if (team == RED)
-    {
-        if (board.teamOn(x - 1, y - 1) == EMPTY_TEAM && board.teamOn(x - 2, y - 2) != team)
-        {
-            result.emplace_back(Move{x, y, x - 2, y - 2});
-        }
-        if (board.teamOn(x + 1, y - 1) == EMPTY_TEAM && board.teamOn(x + 2, y - 2) != team)
-        {
-            result.emplace_back(Move{x, y, x + 2, y - 2});
-        }
-        if (board.teamOn(x - 1, y + 1) == EMPTY_TEAM && board.teamOn(x - 2, y + 2) != team && y + 1 <= 4)
-        {
-            result.emplace_back(Move{x, y, x - 2, y + 2});
-        }
-        if (board.teamOn(x + 1, y + 1) == EMPTY_TEAM && board.teamOn(x + 2, y + 2) != team && y + 1 <= 4)
-        {
-            result.emplace_back(Move{x, y, x + 2, y + 2});
-        }
-    }
-    else
-    {
-        if (board.teamOn(x + 1, y + 1) == EMPTY_TEAM && board.teamOn(x + 2, y + 2) != team)
-        {
-            result.emplace_back(Move{x, y, x + 2, y + 2});
-        }
-        if (board.teamOn(x + 1, y - 1) == EMPTY_TEAM && board.teamOn(x + 2, y - 2) != team && y - 1 >= 5)
-        {
-            result.emplace_back(Move{x, y, x + 2, y - 2});
-        }
-        if (board.teamOn(x - 1, y + 1) == EMPTY_TEAM && board.teamOn(x - 2, y + 2) != team)
-        {
-            result.emplace_back(Move{x, y, x - 2, y + 2});
-        }
-        if (board.teamOn(x - 1, y - 1) == EMPTY_TEAM && board.teamOn(x - 2, y - 2) != team && y - 1 >= 5)
-        {
-            result.emplace_back(Move{x, y, x - 2, y - 2});
-        }
-    }
-
-    return result;
+    // 象眼没有棋子时走田字, 不过河
+    const Bitboard90 targets = board.bitboard->bishopAttacks(team, x * 10 + y);
+    MovesGen::addTargets(x, y, targets & ~board.bitboard->getTeam(team), result);
 }
 
-MOVES MovesGen::knight(TEAM team, Board& board, int x, int y)
+void MovesGen::knight(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    if (board.teamOn(x, y - 1) == EMPTY_TEAM)
-    {
-        TEAM t1 = board.teamOn(x - 1, y - 2);
-        TEAM t2 = board.teamOn(x + 1, y - 2);
-        if (t1 != team && t1 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x - 1, y - 2});
-        }
-        if (t2 != team && t2 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x + 1, y - 2});
-        }
-    }
-    if (board.teamOn(x, y + 1) == EMPTY_TEAM)
-    {
-        TEAM t1 = board.teamOn(x - 1, y + 2);
-        TEAM t2 = board.teamOn(x + 1, y + 2);
-        if (t1 != team && t1 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x - 1, y + 2});
-        }
-        if (t2 != team && t2 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x + 1, y + 2});
-        }
-    }
-    if (board.teamOn(x - 1, y) == EMPTY_TEAM)
-    {
-        TEAM t1 = board.teamOn(x - 2, y + 1);
-        TEAM t2 = board.teamOn(x - 2, y - 1);
-        if (t1 != team && t1 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x - 2, y + 1});
-        }
-        if (t2 != team && t2 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x - 2, y - 1});
-        }
-    }
-    if (board.teamOn(x + 1, y) == EMPTY_TEAM)
-    {
-        TEAM t1 = board.teamOn(x + 2, y + 1);
-        TEAM t2 = board.teamOn(x + 2, y - 1);
-        if (t1 != team && t1 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x + 2, y + 1});
-        }
-        if (t2 != team && t2 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x + 2, y - 1});
-        }
-    }
-
-    return result;
+    // 马腿没有棋子时走日字
+    const Bitboard90 targets = board.bitboard->knightAttacks(x * 10 + y);
+    MovesGen::addTargets(x, y, targets & ~board.bitboard->getTeam(team), result);
 }
 
-MOVES MovesGen::rook(TEAM team, Board& board, int x, int y)
+void MovesGen::rook(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    // 纵向着法
-    UINT32 bitlineX = board.getBitLineX(x);
-    REGION_ROOK regionX = board.bitboard->getRookRegion(bitlineX, y, 9);
-    for (int y2 = y + 1; y2 < regionX[1]; y2++)
-    {
-        result.emplace_back(Move{x, y, x, y2});
-    }
-    if (board.teamOn(x, regionX[1]) != team)
-    {
-        result.emplace_back(Move{x, y, x, regionX[1]});
-    }
-    for (int y2 = y - 1; y2 > regionX[0]; y2--)
-    {
-        result.emplace_back(Move{x, y, x, y2});
-    }
-    if (board.teamOn(x, regionX[0]) != team)
-    {
-        result.emplace_back(Move{x, y, x, regionX[0]});
-    }
-
-    // 横向着法
-    UINT32 bitlineY = board.getBitLineY(y);
-    REGION_ROOK regionY = board.bitboard->getRookRegion(bitlineY, x, 8);
-    for (int x2 = x + 1; x2 < regionY[1]; x2++)
-    {
-        result.emplace_back(Move{x, y, x2, y});
-    }
-    if (board.teamOn(regionY[1], y) != team)
-    {
-        result.emplace_back(Move{x, y, regionY[1], y});
-    }
-    for (int x2 = x - 1; x2 > regionY[0]; x2--)
-    {
-        result.emplace_back(Move{x, y, x2, y});
-    }
-    if (board.teamOn(regionY[0], y) != team)
-    {
-        result.emplace_back(Move{x, y, regionY[0], y});
-    }
-
-    return result;
+    const Bitboard90 targets = board.bitboard->rookAttacks(x, y);
+    MovesGen::addTargets(x, y, targets & ~board.bitboard->getTeam(team), result);
 }
 
-MOVES MovesGen::cannon(TEAM team, Board& board, int x, int y)
+void MovesGen::cannon(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    // 横向着法
-    UINT32 bitlineY = board.getBitLineY(y);
-    REGION_CANNON regionY = board.bitboard->getCannonRegion(bitlineY, x, 8);
-    for (int x2 = x + 1; x2 <= regionY[2]; x2++)
-    {
-        result.emplace_back(Move{x, y, x2, y});
-    }
-    if (board.teamOn(regionY[3], y) == -team && regionY[3] != regionY[2])
-    {
-        result.emplace_back(Move{x, y, regionY[3], y});
-    }
-    for (int x2 = x - 1; x2 >= regionY[1]; x2--)
-    {
-        result.emplace_back(Move{x, y, x2, y});
-    }
-    if (board.teamOn(regionY[0], y) == -team && regionY[0] != regionY[1])
-    {
-        result.emplace_back(Move{x, y, regionY[0], y});
-    }
-
-    // 纵向着法
-    UINT32 bitlineX = board.getBitLineX(x);
-    REGION_CANNON regionX = board.bitboard->getCannonRegion(bitlineX, y, 9);
-    for (int y2 = y + 1; y2 <= regionX[2]; y2++)
-    {
-        result.emplace_back(Move{x, y, x, y2});
-    }
-    if (board.teamOn(x, regionX[3]) == -team && regionX[3] != regionX[2])
-    {
-        result.emplace_back(Move{x, y, x, regionX[3]});
-    }
-    for (int y2 = y - 1; y2 >= regionX[1]; y2--)
-    {
-        result.emplace_back(Move{x, y, x, y2});
-    }
-    if (board.teamOn(x, regionX[0]) == -team && regionX[0] != regionX[1])
-    {
-        result.emplace_back(Move{x, y, x, regionX[0]});
-    }
-
-    return result;
+    // 不吃子时和车一样走到空位, 吃子时需要隔一个炮架
+    const Bitboard90 quiet = board.bitboard->rookAttacks(x, y) & ~board.bitboard->getOccupied();
+    const Bitboard90 captures = board.bitboard->cannonCaptures(x, y) & board.bitboard->getTeam(-team);
+    MovesGen::addTargets(x, y, quiet | captures, result);
 }
 
-MOVES MovesGen::pawn(TEAM team, Board& board, int x, int y)
+void MovesGen::pawn(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    if (team == RED)
-    {
-        if (board.teamOn(x, y + 1) != team && board.teamOn(x, y + 1) != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x, y + 1});
-        }
-        // 如果过河了
-        if (y > 4)
-        {
-            if (board.teamOn(x - 1, y) != team && x - 1 >= 0)
-            {
-                result.emplace_back(Move{x, y, x - 1, y});
-            }
-            if (board.teamOn(x + 1, y) != team && x + 1 <= 8)
-            {
-                result.emplace_back(Move{x, y, x + 1, y});
-            }
-        }
-    }
-    else
-    {
-        if (board.teamOn(x, y - 1) != team && board.teamOn(x, y - 1) != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x, y - 1});
-        }
-        // 如果过河了
-        if (y < 5)
-        {
-            if (board.teamOn(x - 1, y) != team && x - 1 >= 0)
-            {
-                result.emplace_back(Move{x, y, x - 1, y});
-            }
-            if (board.teamOn(x + 1, y) != team && x + 1 <= 8)
-            {
-                result.emplace_back(Move{x, y, x + 1, y});
-            }
-        }
-    }
-
-    return result;
+    // 向前一格, 过河后可以左右各一格
+    const Bitboard90 targets = board.bitboard->getTables().pawnAttacks[AttackTables::teamIndex(team)][x * 10 + y];
+    MovesGen::addTargets(x, y, targets & ~board.bitboard->getTeam(team), result);
 }
 
-MOVES MovesGen::generateMovesOn(Board& board, int x, int y)
+void MovesGen::generateMovesOn(Board& board, int x, int y, MoveList& result)
 {
     const PIECEID pieceid = abs(board.pieceidOn(x, y));
     const TEAM team = board.teamOn(x, y);
 
     if (pieceid == R_KING)
     {
-        return MovesGen::king(team, board, x, y);
+        MovesGen::king(team, board, x, y, result);
     }
     else if (pieceid == R_GUARD)
     {
-        return MovesGen::guard(team, board, x, y);
+        MovesGen::guard(team, board, x, y, result);
     }
     else if (pieceid == R_BISHOP)
     {
-        return MovesGen::bishop(team, board, x, y);
+        MovesGen::bishop(team, board, x, y, result);
     }
     else if (pieceid == R_KNIGHT)
     {
-        return MovesGen::knight(team, board, x, y);
+        MovesGen::knight(team, board, x, y, result);
     }
     else if (pieceid == R_ROOK)
     {
-        return MovesGen::rook(team, board, x, y);
+        MovesGen::rook(team, board, x, y, result);
     }
     else if (pieceid == R_CANNON)
     {
-        return MovesGen::cannon(team, board, x, y);
+        MovesGen::cannon(team, board, x, y, result);
     }
     else if (pieceid == R_PAWN)
     {
-        return MovesGen::pawn(team, board, x, y);
-    }
-    else
-    {
-        return MOVES{};
+        MovesGen::pawn(team, board, x, y, result);
     }
 }
 
-MOVES MovesGen::getMoves(Board& board)
+void MovesGen::getMoves(Board& board, MoveList& result)
 {
-    // 对面笑
-    const MOVES facedkings = MovesGen::facedKings(board);
-    if (facedkings.size() != 0)
-    {
-        return facedkings;
-    }
-
-    MOVES moves{};
-
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_ROOK))
-    {
-        std::vector<Move> ret = MovesGen::generateMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
-    }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_CANNON))
-    {
-        std::vector<Move> ret = MovesGen::generateMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
-    }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_KNIGHT))
-    {
-        std::vector<Move> ret = MovesGen::generateMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
-    }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_PAWN))
-    {
-        std::vector<Move> ret = MovesGen::generateMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
-    }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_BISHOP))
-    {
-        std::vector<Move> ret = MovesGen::generateMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
-    }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_GUARD))
+    if (board.isChecked())
     {
-        std::vector<Move> ret = MovesGen::generateMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
+        MovesGen::getPseudoEvasions(board, result);
     }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_KING))
-    {
-        std::vector<Move> ret = MovesGen::generateMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
-    }
-
-    MOVES result{};
-    for (Move move : moves)
+    else
     {
-        board.doMoveSimple(move);
-        const bool skip = board.inCheck(-board.team);
-        board.undoMoveSimple();
-        if (!skip)
-        {
-            move.attacker = board.piecePosition(move.x1, move.y1);
-            move.captured = board.piecePosition(move.x2, move.y2);
-            result.emplace_back(move);
-        }
+        MovesGen::getPseudoMoves(board, result);
     }
-
-    return result;
+    MovesGen::removeIllegalMoves(board, result);
 }
 
-MOVES MovesGen::kingCapture(TEAM team, Board& board, int x, int y)
+void MovesGen::getPseudoMoves(Board& board, MoveList& result)
 {
-    MOVES result{};
-
-    // 横坐标应当在3, 5之间, 纵坐标的话, 红方在0, 2之间, 黑方在7, 9之间
-    const int left = x - 1;
-    const int right = x + 1;
-    const int up = y + 1;
-    const int down = y - 1;
+    // 只生成伪合法着法, 合法性由搜索在真正走子前用 Board::isLegalMove 检查
+    result.clear();
 
-    if (left >= 3 && board.teamOn(left, y) == -team)
-    {
-        result.emplace_back(Move{x, y, left, y});
-    }
-    if (right <= 5 && board.teamOn(right, y) == -team)
-    {
-        result.emplace_back(Move{x, y, right, y});
-    }
-    if (team == RED)
-    {
-        if (up <= 2 && board.teamOn(x, up) == -team)
-        {
-            result.emplace_back(Move{x, y, x, up});
-        }
-        if (down >= 0 && board.teamOn(x, down) == -team)
-        {
-            result.emplace_back(Move{x, y, x, down});
-        }
-    }
-    else
+    // 对面笑
+    if (MovesGen::facedKings(board, result))
     {
-        if (up <= 9 && board.teamOn(x, up) == -team)
-        {
-            result.emplace_back(Move{x, y, x, up});
-        }
-        if (down >= 7 && board.teamOn(x, down) == -team)
-        {
-            result.emplace_back(Move{x, y, x, down});
-        }
+        return;
     }
 
-    return result;
+    MovesGen::generatePiecesOf(board, R_ROOK, result, false);
+    MovesGen::generatePiecesOf(board, R_CANNON, result, false);
+    MovesGen::generatePiecesOf(board, R_KNIGHT, result, false);
+    MovesGen::generatePiecesOf(board, R_PAWN, result, false);
+    MovesGen::generatePiecesOf(board, R_BISHOP, result, false);
+    MovesGen::generatePiecesOf(board, R_GUARD, result, false);
+    MovesGen::generatePiecesOf(board, R_KING, result, false);
 }
 
-MOVES MovesGen::guardCapture(TEAM team, Board& board, int x, int y)
+void MovesGen::kingCapture(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    // 横坐标也应在3, 5之间, 纵坐标的话, 红方在0, 2之间, 黑方在7, 9之间
-    const int left = x - 1;
-    const int right = x + 1;
-    const int up = y + 1;
-    const int down = y - 1;
-    if (left >= 3)
-    {
-        if (team == RED)
-        {
-            if (board.teamOn(left, up) == -team && up <= 2)
-            {
-                result.emplace_back(Move{x, y, left, up});
-            }
-            if (board.teamOn(left, down) == -team && down >= 0)
-            {
-                result.emplace_back(Move{x, y, left, down});
-            }
-        }
-        else
-        {
-            if (board.teamOn(left, up) == -team && up <= 9)
-            {
-                result.emplace_back(Move{x, y, left, up});
-            }
-            if (board.teamOn(left, down) == -team && down >= 7)
-            {
-                result.emplace_back(Move{x, y, left, down});
-            }
-        }
-    }
-    if (right <= 5)
-    {
-        if (team == RED)
-        {
-            if (board.teamOn(right, up) == -team && up <= 2)
-            {
-                result.emplace_back(Move{x, y, right, up});
-            }
-            if (board.teamOn(right, down) == -team && down >= 0)
-            {
-                result.emplace_back(Move{x, y, right, down});
-            }
-        }
-        else
-        {
-            if (board.teamOn(right, up) == -team && up <= 9)
-            {
-                result.emplace_back(Move{x, y, right, up});
-            }
-            if (board.teamOn(right, down) == -team && down >= 7)
-            {
-                result.emplace_back(Move{x, y, right, down});
-            }
-        }
-    }
-
-    return result;
+    const Bitboard90 targets = board.bitboard->getTables().kingSteps[AttackTables::teamIndex(team)][x * 10 + y];
+    MovesGen::addTargets(x, y, targets & board.bitboard->getTeam(-team), result);
 }
 
-MOVES MovesGen::bishopCapture(TEAM team, Board& board, int x, int y)
+void MovesGen::guardCapture(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    // 横坐标应在0, 9之间, 纵坐标的话, 红方在0, 4之间, 黑方在5, 9之间
-    if (team == RED)
-    {
-        if (board.teamOn(x - 1, y - 1) == EMPTY_TEAM && board.teamOn(x - 2, y - 2) == -team)
-        {
-            result.emplace_back(Move{x, y, x - 2, y - 2});
-        }
-        if (board.teamOn(x + 1, y - 1) == EMPTY_TEAM && board.teamOn(x + 2, y - 2) == -team)
-        {
-            result.emplace_back(Move{x, y, x + 2, y - 2});
-        }
-        if (board.teamOn(x - 1, y + 1) == EMPTY_TEAM && board.teamOn(x - 2, y + 2) == -team && y + 1 <= 4)
-        {
-            result.emplace_back(Move{x, y, x - 2, y + 2});
-        }
-        if (board.teamOn(x + 1, y + 1) == EMPTY_TEAM && board.teamOn(x + 2, y + 2) == -team && y + 1 <= 4)
-        {
-            result.emplace_back(Move{x, y, x + 2, y + 2});
-        }
-    }
-    else
-    {
-        if (board.teamOn(x + 1, y + 1) == EMPTY_TEAM && board.teamOn(x + 2, y + 2) == -team)
-        {
-            result.emplace_back(Move{x, y, x + 2, y + 2});
-        }
-        if (board.teamOn(x + 1, y - 1) == EMPTY_TEAM && board.teamOn(x + 2, y - 2) == -team && y - 1 >= 5)
-        {
-            result.emplace_back(Move{x, y, x + 2, y - 2});
-        }
-        if (board.teamOn(x - 1, y + 1) == EMPTY_TEAM && board.teamOn(x - 2, y + 2) == -team)
-        {
-            result.emplace_back(Move{x, y, x - 2, y + 2});
-        }
-        if (board.teamOn(x - 1, y - 1) == EMPTY_TEAM && board.teamOn(x - 2, y - 2) == -team && y - 1 >= 5)
-        {
-            result.emplace_back(Move{x, y, x - 2, y - 2});
-        }
-    }
-
-    return result;
+    const Bitboard90 targets = board.bitboard->getTables().guardSteps[AttackTables::teamIndex(team)][x * 10 + y];
+    MovesGen::addTargets(x, y, targets & board.bitboard->getTeam(-team), result);
 }
 
-MOVES MovesGen::knightCapture(TEAM team, Board& board, int x, int y)
+void MovesGen::bishopCapture(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    if (board.teamOn(x, y - 1) == EMPTY_TEAM)
-    {
-        TEAM t1 = board.teamOn(x - 1, y - 2);
-        TEAM t2 = board.teamOn(x + 1, y - 2);
-        if (t1 == -team && t1 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x - 1, y - 2});
-        }
-        if (t2 == -team && t2 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x + 1, y - 2});
-        }
-    }
-    if (board.teamOn(x, y + 1) == EMPTY_TEAM)
-    {
-        TEAM t1 = board.teamOn(x - 1, y + 2);
-        TEAM t2 = board.teamOn(x + 1, y + 2);
-        if (t1 == -team && t1 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x - 1, y + 2});
-        }
-        if (t2 == -team && t2 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x + 1, y + 2});
-        }
-    }
-    if (board.teamOn(x - 1, y) == EMPTY_TEAM)
-    {
-        TEAM t1 = board.teamOn(x - 2, y + 1);
-        TEAM t2 = board.teamOn(x - 2, y - 1);
-        if (t1 == -team && t1 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x - 2, y + 1});
-        }
-        if (t2 == -team && t2 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x - 2, y - 1});
-        }
-    }
-    if (board.teamOn(x + 1, y) == EMPTY_TEAM)
-    {
-        TEAM t1 = board.teamOn(x + 2, y + 1);
-        TEAM t2 = board.teamOn(x + 2, y - 1);
-        if (t1 == -team && t1 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x + 2, y + 1});
-        }
-        if (t2 == -team && t2 != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x + 2, y - 1});
-        }
-    }
-
-    return result;
+    const Bitboard90 targets = board.bitboard->bishopAttacks(team, x * 10 + y);
+    MovesGen::addTargets(x, y, targets & board.bitboard->getTeam(-team), result);
 }
 
-MOVES MovesGen::rookCapture(TEAM team, Board& board, int x, int y)
+void MovesGen::knightCapture(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    // 纵向着法
-    UINT32 bitlineX = board.getBitLineX(x);
-    REGION_ROOK regionX = board.bitboard->getRookRegion(bitlineX, y, 9);
-    if (board.teamOn(x, regionX[1]) == -team)
-    {
-        result.emplace_back(Move{x, y, x, regionX[1]});
-    }
-    if (board.teamOn(x, regionX[0]) == -team)
-    {
-        result.emplace_back(Move{x, y, x, regionX[0]});
-    }
-
-    // 横向着法
-    UINT32 bitlineY = board.getBitLineY(y);
-    REGION_ROOK regionY = board.bitboard->getRookRegion(bitlineY, x, 8);
-    if (board.teamOn(regionY[1], y) == -team)
-    {
-        result.emplace_back(Move{x, y, regionY[1], y});
-    }
-    if (board.teamOn(regionY[0], y) == -team)
-    {
-        result.emplace_back(Move{x, y, regionY[0], y});
-    }
-
-    return result;
+    const Bitboard90 targets = board.bitboard->knightAttacks(x * 10 + y);
+    MovesGen::addTargets(x, y, targets & board.bitboard->getTeam(-team), result);
 }
 
-MOVES MovesGen::cannonCapture(TEAM team, Board& board, int x, int y)
+void MovesGen::rookCapture(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    // 横向着法
-    UINT32 bitlineY = board.getBitLineY(y);
-    REGION_CANNON regionY = board.bitboard->getCannonRegion(bitlineY, x, 8);
-    if (board.teamOn(regionY[3], y) == -team && regionY[3] != regionY[2])
-    {
-        result.emplace_back(Move{x, y, regionY[3], y});
-    }
-    if (board.teamOn(regionY[0], y) == -team && regionY[0] != regionY[1])
-    {
-        result.emplace_back(Move{x, y, regionY[0], y});
-    }
-
-    // 纵向着法
-    UINT32 bitlineX = board.getBitLineX(x);
-    REGION_CANNON regionX = board.bitboard->getCannonRegion(bitlineX, y, 9);
-    if (board.teamOn(x, regionX[3]) == -team && regionX[3] != regionX[2])
-    {
-        result.emplace_back(Move{x, y, x, regionX[3]});
-    }
-    if (board.teamOn(x, regionX[0]) == -team && regionX[0] != regionX[1])
-    {
-        result.emplace_back(Move{x, y, x, regionX[0]});
-    }
-
-    return result;
+    const Bitboard90 targets = board.bitboard->rookAttacks(x, y);
+    MovesGen::addTargets(x, y, targets & board.bitboard->getTeam(-team), result);
 }
 
-MOVES MovesGen::pawnCapture(TEAM team, Board& board, int x, int y)
+void MovesGen::cannonCapture(TEAM team, Board& board, int x, int y, MoveList& result)
 {
-    MOVES result{};
-
-    if (team == RED)
-    {
-        if (board.teamOn(x, y + 1) == -team && board.teamOn(x, y + 1) != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x, y + 1});
-        }
-        // 如果过河了
-        if (y > 4)
-        {
-            if (board.teamOn(x - 1, y) == -team && x - 1 >= 0)
-            {
-                result.emplace_back(Move{x, y, x - 1, y});
-            }
-            if (board.teamOn(x + 1, y) == -team && x + 1 <= 8)
-            {
-                result.emplace_back(Move{x, y, x + 1, y});
-            }
-        }
-    }
-    else
-    {
-        if (board.teamOn(x, y - 1) == -team && board.teamOn(x, y - 1) != OVERFLOW_TEAM)
-        {
-            result.emplace_back(Move{x, y, x, y - 1});
-        }
-        // 如果过河了
-        if (y < 5)
-        {
-            if (board.teamOn(x - 1, y) == -team && x - 1 >= 0)
-            {
-                result.emplace_back(Move{x, y, x - 1, y});
-            }
-            if (board.teamOn(x + 1, y) == -team && x + 1 <= 8)
-            {
-                result.emplace_back(Move{x, y, x + 1, y});
-            }
-        }
-    }
+    const Bitboard90 targets = board.bitboard->cannonCaptures(x, y);
+    MovesGen::addTargets(x, y, targets & board.bitboard->getTeam(-team), result);
+}
 
-    return result;
+void MovesGen::pawnCapture(TEAM team, Board& board, int x, int y, MoveList& result)
+{
+    const Bitboard90 targets = board.bitboard->getTables().pawnAttacks[AttackTables::teamIndex(team)][x * 10 + y];
+    MovesGen::addTargets(x, y, targets & board.bitboard->getTeam(-team), result);
 }
 
-MOVES MovesGen::generateCaptureMovesOn(Board& board, int x, int y)
+void MovesGen::generateCaptureMovesOn(Board& board, int x, int y, MoveList& result)
 {
     const PIECEID pieceid = board.pieceidOn(x, y);
     const TEAM team = board.teamOn(x, y);
 
     if (pieceid == R_KING || pieceid == B_KING)
     {
-        return MovesGen::kingCapture(team, board, x, y);
+        MovesGen::kingCapture(team, board, x, y, result);
     }
     else if (pieceid == R_GUARD || pieceid == B_GUARD)
     {
-        return MovesGen::guardCapture(team, board, x, y);
+        MovesGen::guardCapture(team, board, x, y, result);
     }
     else if (pieceid == R_BISHOP || pieceid == B_BISHOP)
     {
-        return MovesGen::bishopCapture(team, board, x, y);
+        MovesGen::bishopCapture(team, board, x, y, result);
     }
     else if (pieceid == R_KNIGHT || pieceid == B_KNIGHT)
     {
-        return MovesGen::knightCapture(team, board, x, y);
+        MovesGen::knightCapture(team, board, x, y, result);
     }
     else if (pieceid == R_ROOK || pieceid == B_ROOK)
     {
-        return MovesGen::rookCapture(team, board, x, y);
+        MovesGen::rookCapture(team, board, x, y, result);
     }
     else if (pieceid == R_CANNON || pieceid == B_CANNON)
     {
-        return MovesGen::cannonCapture(team, board, x, y);
+        MovesGen::cannonCapture(team, board, x, y, result);
     }
     else if (pieceid == R_PAWN || pieceid == B_PAWN)
     {
-        return MovesGen::pawnCapture(team, board, x, y);
-    }
-    else
-    {
-        return MOVES{};
+        MovesGen::pawnCapture(team, board, x, y, result);
     }
 }
 
-MOVES MovesGen::getCaptureMoves(Board& board)
+void MovesGen::getCaptureMoves(Board& board, MoveList& result)
+{
+    MovesGen::getPseudoCaptureMoves(board, result);
+    MovesGen::removeIllegalMoves(board, result);
+}
+
+void MovesGen::getPseudoCaptureMoves(Board& board, MoveList& result)
 {
+    result.clear();
+
     // 对面笑
-    const MOVES facedkings = MovesGen::facedKings(board);
-    if (facedkings.size() != 0)
+    if (MovesGen::facedKings(board, result))
     {
-        return facedkings;
+        return;
     }
 
-    MOVES moves{};
+    MovesGen::generatePiecesOf(board, R_ROOK, result, true);
+    MovesGen::generatePiecesOf(board, R_PAWN, result, true);
+    MovesGen::generatePiecesOf(board, R_CANNON, result, true);
+    MovesGen::generatePiecesOf(board, R_KNIGHT, result, true);
+    MovesGen::generatePiecesOf(board, R_BISHOP, result, true);
+    MovesGen::generatePiecesOf(board, R_GUARD, result, true);
+    MovesGen::generatePiecesOf(board, R_KING, result, true);
+}
 
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_ROOK))
-    {
-        std::vector<Move> ret = MovesGen::generateCaptureMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
-    }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_PAWN))
-    {
-        std::vector<Move> ret = MovesGen::generateCaptureMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
-    }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_CANNON))
+void MovesGen::getPseudoEvasions(Board& board, MoveList& result)
+{
+    // 被将军时只生成 将的着法、吃掉将军的棋子、垫子, 炮将军时还包括移开本方的炮架
+    result.clear();
+
+    // 对面笑
+    if (MovesGen::facedKings(board, result))
     {
-        std::vector<Move> ret = MovesGen::generateCaptureMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
+        return;
     }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_KNIGHT))
+
+    // 双将很少能用一步棋同时化解, 直接生成全部着法
+    const Bitboard90 checkers = board.getCheckers();
+    Bitboard90 others = checkers;
+    if (!others.empty())
     {
-        std::vector<Move> ret = MovesGen::generateCaptureMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
+        others.popLsb();
     }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_BISHOP))
+    if (checkers.empty() || !others.empty())
     {
-        std::vector<Move> ret = MovesGen::generateCaptureMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
+        MovesGen::getPseudoMoves(board, result);
+        return;
     }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_GUARD))
+
+    const TEAM team = board.team;
+    const Piece king = board.getPieceByType(R_KING * team);
+    const int checkerSq = checkers.first();
+    const int cx = checkerSq / 10;
+    const int cy = checkerSq % 10;
+    const PIECEID checker = abs(board.pieceidOn(cx, cy));
+    Bitboard90 targets = checkers;
+    int screenX = -1;
+    int screenY = -1;
+    if (checker == R_ROOK || checker == R_CANNON || checker == R_KING)
     {
-        std::vector<Move> ret = MovesGen::generateCaptureMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
+        // 将军的棋子和将之间的空位都可以垫子, 中间的棋子就是炮架
+        const int dx = (king.x > cx) - (king.x < cx);
+        const int dy = (king.y > cy) - (king.y < cy);
+        for (int x = cx + dx, y = cy + dy; x != king.x || y != king.y; x += dx, y += dy)
+        {
+            if (board.pieceidOn(x, y) == EMPTY_PIECEID)
+            {
+                targets.set(x * 10 + y);
+            }
+            else
+            {
+                screenX = x;
+                screenY = y;
+            }
+        }
     }
-    for (const Piece& piece : board.getPiecesPyType(board.team * R_KING))
+    else if (checker == R_KNIGHT)
     {
-        std::vector<Move> ret = MovesGen::generateCaptureMovesOn(board, piece.x, piece.y);
-        moves.insert(moves.end(), ret.begin(), ret.end());
+        // 蹩马腿
+        const int dx = king.x - cx;
+        const int dy = king.y - cy;
+        targets.set(abs(dx) == 2 ? (cx + dx / 2) * 10 + cy : cx * 10 + cy + dy / 2);
     }
 
-    MOVES result{};
-    for (Move move : moves)
+    // 将可以走到任何位置, 其他棋子只能吃子或者垫子
+    MovesGen::king(team, board, king.x, king.y, result);
+    const size_t from = result.size();
+    MovesGen::generatePiecesOf(board, R_ROOK, result, false);
+    MovesGen::generatePiecesOf(board, R_CANNON, result, false);
+    MovesGen::generatePiecesOf(board, R_KNIGHT, result, false);
+    MovesGen::generatePiecesOf(board, R_PAWN, result, false);
+    MovesGen::generatePiecesOf(board, R_BISHOP, result, false);
+    MovesGen::generatePiecesOf(board, R_GUARD, result, false);
+    MovesGen::keepTargets(result, from, targets, true);
+
+    // 移开本方的炮架
+    if (checker == R_CANNON && board.teamOn(screenX, screenY) == team)
     {
-        board.doMoveSimple(move);
-        const bool skip = board.inCheck(-board.team);
-        board.undoMoveSimple();
-        if (!skip)
-        {
-            move.attacker = board.piecePosition(move.x1, move.y1);
-            move.captured = board.piecePosition(move.x2, move.y2);
-            result.emplace_back(move);
-        }
+        const size_t screenFrom = result.size();
+        MovesGen::generateMovesOn(board, screenX, screenY, result);
+        MovesGen::keepTargets(result, screenFrom, targets, false);
     }
-    return result;
 }
 
-MOVES MovesGen::facedKings(const Board& board)
+bool MovesGen::facedKings(const Board& board, MoveList& result)
 {
     const Piece& rKing = board.getPieceByType(board.team * R_KING);
     const Piece& bKing = board.getPieceByType(board.team * B_KING);
@@ -919,19 +343,77 @@ MOVES MovesGen::facedKings(const Board& board)
         REGION_ROOK region = board.bitboard->getRookRegion(bitlineX, rKing.y, 9);
         if (region[1] == bKing.y)
         {
-            MOVES result;
             if (board.team == RED)
             {
-                result = MOVES{Move{rKing.x, rKing.y, bKing.x, bKing.y}};
-                result[0].attacker = rKing;
+                result.emplace_back(Move{rKing.x, rKing.y, bKing.x, bKing.y});
             }
             else
             {
-                result = MOVES{Move{bKing.x, bKing.y, rKing.x, rKing.y}};
-                result[0].attacker = bKing;
+                result.emplace_back(Move{bKing.x, bKing.y, rKing.x, rKing.y});
             }
-            return result;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MovesGen::generatePiecesOf(Board& board, PIECEID pieceid, MoveList& result, bool captureOnly)
+{
+    // 直接遍历棋子索引, 避免构造临时的棋子列表
+    for (PIECE_INDEX index : board.pieceTypes[size_t(board.team * pieceid + 7)])
+    {
+        const Piece& piece = board.pieces[index];
+        if (!piece.isLive)
+        {
+            continue;
+        }
+        if (captureOnly)
+        {
+            MovesGen::generateCaptureMovesOn(board, piece.x, piece.y, result);
+        }
+        else
+        {
+            MovesGen::generateMovesOn(board, piece.x, piece.y, result);
+        }
+    }
+}
+
+void MovesGen::removeIllegalMoves(Board& board, MoveList& moves)
+{
+    // 就地剔除走完后被将军的着法
+    const bool checked = board.isChecked();
+    size_t count = 0;
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        const Move& move = moves[i];
+        if (board.isLegalMove(move, checked))
+        {
+            moves[count++] = move;
+        }
+    }
+    moves.resize(count);
+}
+
+void MovesGen::addTargets(int x, int y, Bitboard90 targets, MoveList& result)
+{
+    while (!targets.empty())
+    {
+        const int sq = targets.popLsb();
+        result.emplace_back(Move{x, y, sq / 10, sq % 10});
+    }
+}
+
+void MovesGen::keepTargets(MoveList& moves, size_t from, Bitboard90 targets, bool inside)
+{
+    // 只保留 from 之后终点在(或不在) targets 中的着法
+    size_t count = from;
+    for (size_t i = from; i < moves.size(); i++)
+    {
+        const Move move = moves[i];
+        if (targets.test(move.x2 * 10 + move.y2) == inside)
+        {
+            moves[count++] = move;
         }
     }
-    return {};
+    moves.resize(count);
 }
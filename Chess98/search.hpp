@@ -1,49 +1,157 @@
 ﻿#pragma once
 #include "heuristic.hpp"
 #include "movesgen.hpp"
+#include "timeman.hpp"
+#include "book.hpp"
+
+// 单个线程的搜索统计
+// 只由所属线程写入, 主线程输出信息时可随时读取, 计数用不加锁的原子读写
+class SearchStats
+{
+public:
+    SearchStats() = default;
+    void clear()
+    {
+        nodes.store(0, std::memory_order_relaxed);
+        qnodes.store(0, std::memory_order_relaxed);
+        ttHits.store(0, std::memory_order_relaxed);
+        ttStores.store(0, std::memory_order_relaxed);
+        seldepth.store(0, std::memory_order_relaxed);
+    }
+
+public:
+    std::atomic<uint64> nodes{0};
+    std::atomic<uint64> qnodes{0};
+    std::atomic<uint64> ttHits{0};
+    std::atomic<uint64> ttStores{0};
+    std::atomic<int> seldepth{0};
+
+public:
+    static void inc(std::atomic<uint64>& counter) { counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+    void updateSeldepth(int distance)
+    {
+        if (distance > seldepth.load(std::memory_order_relaxed))
+        {
+            seldepth.store(distance, std::memory_order_relaxed);
+        }
+    }
+    uint64 totalNodes() const { return nodes.load(std::memory_order_relaxed) + qnodes.load(std::memory_order_relaxed); }
+    void merge(const SearchStats& other)
+    {
+        nodes.store(nodes.load(std::memory_order_relaxed) + other.nodes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        qnodes.store(qnodes.load(std::memory_order_relaxed) + other.qnodes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        ttHits.store(ttHits.load(std::memory_order_relaxed) + other.ttHits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        ttStores.store(ttStores.load(std::memory_order_relaxed) + other.ttStores.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        this->updateSeldepth(other.seldepth.load(std::memory_order_relaxed));
+    }
+};
 
 class Search
 {
 public:
     Search() = default;
     Search(PIECEID_MAP pieceidMap, TEAM team) : board(Board(pieceidMap, team)) {}
+    Search(const Board& board, std::shared_ptr<Tt> tt) : board(board), tt(std::move(tt)) {}
+    Search(const Search&) = delete;
+    Search& operator=(const Search&) = delete;
+    ~Search() { this->shutdownHelpers(); }
+    // 停止标志不在这里清除, 搜索开始前收到的停止请求不会丢失
     void reset()
     {
-        this->rootMoves = {};
+        this->rootMoves.clear();
         board.distance = 0;
         board.initEvaluate();
-        this->history->reset();
+        this->history->decay();
         this->killer->reset();
-        this->tt->reset();
-        this->bannedMoves.clear();
-        this->stop = false;
+        this->pv->reset();
+        this->tt->newSearch();
+        this->stats.clear();
         this->info.clear();
     }
+    // 更换局面, 禁着只对设置后的下一次搜索有效
+    void setBoard(const Board& newBoard)
+    {
+        this->board = newBoard;
+        this->bannedMoves = {{2324, 1}};
+    }
 
 public:
     Board board{};
-    MOVES rootMoves{};
+    MoveList rootMoves;
     std::unique_ptr<HistoryTable> history = std::make_unique<HistoryTable>();
     std::unique_ptr<KillerTable> killer = std::make_unique<KillerTable>();
-    std::unique_ptr<Tt> tt = std::make_unique<Tt>();
+    std::unique_ptr<PvTable> pv = std::make_unique<PvTable>();
+    std::shared_ptr<Tt> tt = std::make_shared<Tt>();
+    std::shared_ptr<OpenBook> book = OpenBook::shared();
 
 public:
     bool useBook = true;
-    bool stop = false;
+    int threads = 1;
+    int multiPV = 1;
+    std::atomic<bool> stop{false};
+    SearchStats stats{};
     std::unordered_map<int, bool> bannedMoves{{2324, 1}};
     Information info{};
 
 public:
     Result searchMain(int maxDepth, int maxTime);
+    Result searchMain(int maxDepth, const TimeLimits& limits);
     Result searchOpenBook() const;
-    Result searchRoot(int depth);
+    Result searchRoot(int depth, int alpha = -INF, int beta = INF, size_t firstMove = 0);
     int searchPV(int depth, int alpha, int beta);
     int searchCut(int depth, int beta, bool banNullMove = false);
     int searchQ(int alpha, int beta, int leftDistance);
+    uint64 nodesSearched() const;
+    int seldepth() const;
+    void setPondering(bool ponder) { this->timeManager.setPondering(ponder); }
+    void ponderhit();
+
+public:
+    // 主要变例中预计的对方应着, 随 bestmove 一起输出供后台思考使用
+    Move ponderMove{};
+    // 最后一次完成的迭代中各条主要变例, 按分值从高到低排列
+    std::vector<PvLine> rootLines{};
+
+protected:
+    // 辅助线程池, 线程在多次搜索之间保留, 线程数变化时才重建
+    std::vector<std::unique_ptr<Search>> helpers{};
+    std::vector<std::thread> helperThreads{};
+    std::mutex poolMutex{};
+    std::condition_variable poolCv{};
+    std::condition_variable poolIdleCv{};
+    uint64 poolGeneration = 0;
+    int poolMaxDepth = 0;
+    size_t poolRunning = 0;
+    bool poolExit = false;
+    // 当前节点是否处在上一次迭代的主要变例上
+    bool followPv = false;
+    // 时间管理, 只有主线程启用
+    TimeManager timeManager{};
+    int rootDepth = 0;
+    uint32 pollCounter = 0;
+    void pollTime()
+    {
+        // 每隔一定节点数检查一次硬限制, 第一层迭代总是完整搜完
+        // 后台思考期间已经用完正常用时的, ponderhit 之后直接以最后一次完成的迭代结果出着
+        if ((++this->pollCounter & 1023) == 0 && this->rootDepth > 1 &&
+            (this->timeManager.hardExpired() || this->timeManager.ponderhitExpired()))
+        {
+            this->stop = true;
+        }
+    }
+
+protected:
+    void startHelpers(int maxDepth);
+    void stopHelpers();
+    void shutdownHelpers();
+    void helperLoop(int id, uint64 generation);
+    void searchHelper(int id, int maxDepth);
 
 protected:
     const int Q_DEPTH = 64;
     const int Q_DEPTH_CHECKING = 8;
+    const int ASPIRATION_WINDOW = 100;
+    const int ASPIRATION_MIN_DEPTH = 4;
 
 protected:
     Trick nullAndDeltaPruning(int& alpha, int& beta, int& vlBest) const;
@@ -99,7 +207,7 @@ Trick Search::multiProbCut(SEARCH_TYPE searchType, int alpha, int beta, int dept
 {
     if ((depth % 4 == 0 && searchType == CUT) || searchType == PV)
     {
-        const double vlScale = (double)vlPawn / 100.0;
+        const double vlScale = (double)board.evalContext->vlPawn / 100.0;
         const double a = 1.02 * vlScale;
         const double b = 2.36 * vlScale;
         const double sigma = 82.0 * vlScale;
@@ -119,10 +227,53 @@ Trick Search::multiProbCut(SEARCH_TYPE searchType, int alpha, int beta, int dept
     return {};
 }
 
+uint64 Search::nodesSearched() const
+{
+    uint64 nodes = this->stats.totalNodes();
+    for (const std::unique_ptr<Search>& helper : this->helpers)
+    {
+        nodes += helper->stats.totalNodes();
+    }
+    return nodes;
+}
+
+void Search::ponderhit()
+{
+    // 只转为正常计时, 停止与否由搜索线程在 pollTime 和迭代之间判断
+    this->timeManager.ponderhit();
+}
+
+int Search::seldepth() const
+{
+    int result = this->stats.seldepth.load(std::memory_order_relaxed);
+    for (const std::unique_ptr<Search>& helper : this->helpers)
+    {
+        result = std::max(result, helper->stats.seldepth.load(std::memory_order_relaxed));
+    }
+    return result;
+}
+
 Result Search::searchMain(int maxDepth, int maxTimeMs = 3)
 {
+    return this->searchMain(maxDepth, TimeLimits::fixed(maxTimeMs));
+}
+
+Result Search::searchMain(int maxDepth, const TimeLimits& limits)
+{
+    // 搜索开始前已收到的停止请求, 完成第一层迭代后立即返回
+    // 返回时清除停止标志, 不影响下一次搜索
+    const bool stopRequested = this->stop.exchange(false);
+    struct StopReset
+    {
+        std::atomic<bool>& stop;
+        ~StopReset() { stop = false; }
+    } stopReset{this->stop};
+
     // 预制条件检查
     this->reset();
+    this->timeManager.start(limits);
+    this->ponderMove = Move{};
+    this->rootLines.clear();
     if (!board.isKingLive(RED) || !board.isKingLive(BLACK))
     {
         // 将帅是否在棋盘上
@@ -149,328 +300,385 @@ Result Search::searchMain(int maxDepth, int maxTimeMs = 3)
     }
 
     // 搜索
-    rootMoves = MovesGen::getMoves(board);
+    MovesGen::getMoves(board, rootMoves);
     Result bestNode = Result(Move(), 0);
 
-    // time start
-    auto start = std::chrono::high_resolution_clock::now();
+    // Lazy SMP, 辅助线程共享置换表
+    this->startHelpers(maxDepth);
+
     for (int depth = 1; depth <= maxDepth; depth++)
     {
-        Result ret = searchRoot(depth);
-        if (!stop)
-        {
-            bestNode = ret;
+        this->rootDepth = depth;
+
+        // 多主要变例, 第 i 条变例在排除前 i 个着法后搜索, 置换表和历史表在各条变例之间共享
+        const size_t lineCount = std::max<size_t>(std::min<size_t>(size_t(std::max(this->multiPV, 1)), rootMoves.size()), 1);
+        std::vector<PvLine> lines{};
+        for (size_t pvIdx = 0; pvIdx < lineCount; pvIdx++)
+        {
+            // 渴望窗口, 以上一次迭代该变例的分值为中心, 落在窗口外时逐步放宽重搜
+            const bool hasPrevious = pvIdx < this->rootLines.size();
+            const int vlPrevious = hasPrevious ? this->rootLines[pvIdx].vl : 0;
+            this->pv->restore(hasPrevious ? this->rootLines[pvIdx].moves : MOVES{});
+            int delta = this->ASPIRATION_WINDOW;
+            int alpha = -INF;
+            int beta = INF;
+            if (depth >= this->ASPIRATION_MIN_DEPTH && hasPrevious && std::abs(vlPrevious) < BAN)
+            {
+                alpha = std::max(vlPrevious - delta, -INF);
+                beta = std::min(vlPrevious + delta, INF);
+            }
+            Result ret{};
+            while (true)
+            {
+                ret = searchRoot(depth, alpha, beta, pvIdx);
+                if (stop)
+                {
+                    break;
+                }
+                if (ret.vl <= alpha && alpha > -INF)
+                {
+                    beta = (alpha + beta) / 2;
+                    alpha = ret.vl - delta <= -BAN ? -INF : ret.vl - delta;
+                }
+                else if (ret.vl >= beta && beta < INF)
+                {
+                    beta = ret.vl + delta >= BAN ? INF : ret.vl + delta;
+                }
+                else
+                {
+                    break;
+                }
+                delta *= 2;
+            }
+            if (stop)
+            {
+                break;
+            }
+            // 剩下的着法都被禁止时不再增加变例
+            if (ret.move.id() == -1 && pvIdx > 0)
+            {
+                break;
+            }
+            lines.emplace_back(PvLine{ret.move, ret.vl, this->pv->line()});
         }
-        else
+        if (stop)
         {
             break;
         }
 
-        // time check
-        auto end = std::chrono::high_resolution_clock::now();
-        int duration = int(std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+        // 各条变例按分值排序, 根节点着法的前几位与之保持一致
+        std::stable_sort(lines.begin(), lines.end(), [](const PvLine& a, const PvLine& b) { return a.vl > b.vl; });
+        for (size_t i = 0; i < lines.size() && lines.size() > 1; i++)
+        {
+            rootMoves[i] = lines[i].move;
+        }
+        this->rootLines = lines;
+        bestNode = Result{lines[0].move, lines[0].vl};
+
+        const MOVES& pvLine = lines[0].moves;
+        this->ponderMove = pvLine.size() > 1 && pvLine[0] == bestNode.move ? pvLine[1] : Move{};
 
         // info
-        info.setInfo(bestNode.vl, bestNode.move, duration);
+        const int duration = int(this->timeManager.elapsed());
+        info.setInfo(bestNode.vl, bestNode.move, duration, this->seldepth(), this->nodesSearched(), this->tt->hashfull(), pvLine, lines);
 
-        // timeout break
-        if (duration >= maxTimeMs / 3)
+        // 软限制, 剩余时间不够下一次迭代时停止
+        if (!this->timeManager.nextIteration(depth, bestNode.vl, bestNode.move) || stopRequested)
         {
             break;
         }
     }
 
+    // 停止辅助线程
+    this->stopHelpers();
+
     // info clear
     info.clear();
 
     // 防止没有可行着法
-    if (bestNode.move.id == -1)
+    if (bestNode.move.id() == -1)
     {
         const Piece& king = board.getPieceByType(board.team == RED ? R_KING : B_KING);
-        bestNode.move = MovesGen::generateMovesOn(board, king.x, king.y)[0];
+        MoveList kingMoves;
+        MovesGen::generateMovesOn(board, king.x, king.y, kingMoves);
+        if (!kingMoves.empty())
+        {
+            bestNode.move = kingMoves[0];
+        }
     }
 
     return bestNode;
 }
 
-Result Search::searchOpenBook() const
+void Search::startHelpers(int maxDepth)
 {
-    if (!useBook)
-    {
-        return Result{Move{}, -1};
-    }
-    
-    struct Book
+    // 线程数变化时重建线程池, 辅助线程全部创建后再启动, 避免容器扩容
+    if (this->helpers.size() != size_t(std::max(this->threads - 1, 0)))
     {
-        uint32_t dwZobristLock;
-        uint16_t wmv;
-        uint16_t wvl;
-
-        static int bookPosCmp(const Book& bk, int32 hashLock)
+        this->shutdownHelpers();
+        for (int id = 1; id < this->threads; id++)
         {
-            uint32_t bookLock = bk.dwZobristLock;
-            uint32_t boardLock = static_cast<uint32_t>(hashLock);
-            if (bookLock < boardLock)
-                return -1;
-            else if (bookLock > boardLock)
-                return 1;
-            return 0;
+            this->helpers.emplace_back(std::make_unique<Search>(this->board, this->tt));
         }
-    };
-
-    struct BookFile
-    {
-        std::fstream file;
-        int nLen = 0;
-
-        bool open(const char* szFileName, bool bEdit = false)
+        // 新线程从当前世代开始等待, 不会把之前的世代当作新的搜索任务
+        uint64 generation = 0;
         {
-            auto mode = bEdit ? (std::ios::in | std::ios::out | std::ios::binary) : (std::ios::in | std::ios::binary);
-            file.open(szFileName, mode);
-            if (file.is_open())
-            {
-                file.seekg(0, std::ios::end);
-                nLen = static_cast<int>(file.tellg()) / sizeof(Book);
-                return true;
-            }
-            return false;
+            std::lock_guard<std::mutex> lock(this->poolMutex);
+            generation = this->poolGeneration;
         }
-
-        void close()
+        for (int id = 1; id < this->threads; id++)
         {
-            if (file.is_open())
-            {
-                file.close();
-            }
+            this->helperThreads.emplace_back([this, id, generation]() { this->helperLoop(id, generation); });
         }
-
-        void read(Book& bk, int nMid)
-        {
-            file.seekg(nMid * sizeof(Book), std::ios::beg);
-            file.read(reinterpret_cast<char*>(&bk), sizeof(Book));
-        }
-
-        void write(const Book& bk, int nMid)
-        {
-            file.seekp(nMid * sizeof(Book), std::ios::beg);
-            file.write(reinterpret_cast<const char*>(&bk), sizeof(Book));
-        }
-    };
-
-    Book bk{};
-    auto pBookFileStruct = std::make_unique<BookFile>();
-
-    if (!pBookFileStruct->open("BOOK.DAT"))
+    }
+    if (this->helpers.empty())
     {
-        return Result{Move{}, -1};
+        return;
     }
 
-    // 二分法查找开局库
-    int nMid = 0;
-    int32 hashLock = board.hashLock;
-    int32 mirrorHashLock = 0;
-    int32 mirrorHashKey = 0;
-
-    for (int x = 0; x < 9; x++)
+    // 同步局面后唤醒所有辅助线程
     {
-        for (int y = 0; y < 10; y++)
+        std::lock_guard<std::mutex> lock(this->poolMutex);
+        for (std::unique_ptr<Search>& helper : this->helpers)
         {
-            const PIECEID& pid = board.pieceidOn(x, y);
-            if (pid != EMPTY_PIECEID)
-            {
-                mirrorHashKey ^= HASHKEYS[pid][static_cast<size_t>(8) - x][y];
-                mirrorHashLock ^= HASHLOCKS[pid][static_cast<size_t>(8) - x][y];
-            }
+            helper->board = this->board;
+            helper->board.distance = 0;
+            helper->tt = this->tt;
+            helper->bannedMoves = this->bannedMoves;
+            helper->stop = false;
+            helper->stats.clear();
+            helper->history->decay();
+            helper->killer->reset();
+            helper->pv->reset();
         }
+        this->poolMaxDepth = maxDepth;
+        this->poolRunning = this->helpers.size();
+        this->poolGeneration++;
     }
+    this->poolCv.notify_all();
+}
 
-    if (board.team == BLACK)
+void Search::stopHelpers()
+{
+    if (this->helpers.empty())
     {
-        mirrorHashKey ^= PLAYER_KEY;
-        mirrorHashLock ^= PLAYER_LOCK;
+        return;
     }
-
-    int nScan = 0;
-    int32 nowHashLock = 0;
-
-    for (nScan = 0; nScan < 2; nScan++)
+    for (std::unique_ptr<Search>& helper : this->helpers)
     {
-        int nHigh = pBookFileStruct->nLen - 1;
-        int nLow = 0;
-        nowHashLock = (nScan == 0) ? hashLock : mirrorHashLock;
-
-        while (nLow <= nHigh)
-        {
-            nMid = (nHigh + nLow) / 2;
-            pBookFileStruct->read(bk, nMid);
-
-            int cmpResult = Book::bookPosCmp(bk, nowHashLock);
-            if (cmpResult < 0)
-            {
-                nLow = nMid + 1;
-            }
-            else if (cmpResult > 0)
-            {
-                nHigh = nMid - 1;
-            }
-            else
-            {
-                break;
-            }
-        }
-
-        if (nLow <= nHigh)
-        {
-            break;
-        }
+        helper->stop = true;
     }
-
-    if (nScan == 2)
+    // 等待所有辅助线程回到空闲状态
     {
-        pBookFileStruct->close();
-        return Result{Move{}, -1};
+        std::unique_lock<std::mutex> lock(this->poolMutex);
+        this->poolIdleCv.wait(lock, [this]() { return this->poolRunning == 0; });
     }
-
-    // 如果找到局面，则向前查找第一个着法
-    for (nMid--; nMid >= 0; nMid--)
+    // 辅助线程的统计并入主线程
+    for (std::unique_ptr<Search>& helper : this->helpers)
     {
-        pBookFileStruct->read(bk, nMid);
-        if (Book::bookPosCmp(bk, nowHashLock) < 0)
-        {
-            break;
-        }
+        this->stats.merge(helper->stats);
     }
+}
 
-    std::vector<Move> bookMoves;
-
-    // 向后依次读入属于该局面的每个着法
-    for (nMid++; nMid < pBookFileStruct->nLen; nMid++)
+void Search::shutdownHelpers()
+{
+    if (this->helperThreads.empty())
+    {
+        return;
+    }
     {
-        pBookFileStruct->read(bk, nMid);
-        int cmpResult = Book::bookPosCmp(bk, nowHashLock);
+        std::lock_guard<std::mutex> lock(this->poolMutex);
+        this->poolExit = true;
+    }
+    this->poolCv.notify_all();
+    for (std::thread& thread : this->helperThreads)
+    {
+        thread.join();
+    }
+    this->helperThreads.clear();
+    this->helpers.clear();
+    this->poolExit = false;
+}
 
-        if (cmpResult > 0)
+void Search::helperLoop(int id, uint64 generation)
+{
+    Search* helper = this->helpers[size_t(id) - 1].get();
+    while (true)
+    {
+        int maxDepth = 0;
         {
-            break;
+            std::unique_lock<std::mutex> lock(this->poolMutex);
+            this->poolCv.wait(lock, [this, generation]() { return this->poolExit || this->poolGeneration != generation; });
+            if (this->poolExit)
+            {
+                return;
+            }
+            generation = this->poolGeneration;
+            maxDepth = this->poolMaxDepth;
         }
-        else if (cmpResult == 0)
+        helper->searchHelper(id, maxDepth);
         {
-            int mv = bk.wmv;
-            int src = mv & 255;
-            int dst = mv >> 8;
-            int xSrc = (src & 15) - 3;
-            int ySrc = 12 - (src >> 4);
-            int xDst = (dst & 15) - 3;
-            int yDst = 12 - (dst >> 4);
-
-            if (nScan != 0)
+            std::lock_guard<std::mutex> lock(this->poolMutex);
+            if (--this->poolRunning == 0)
             {
-                xSrc = 8 - xSrc;
-                xDst = 8 - xDst;
+                this->poolIdleCv.notify_all();
             }
-
-            int vl = bk.wvl;
-            Move tMove = Move(xSrc, ySrc, xDst, yDst, vl);
-            bookMoves.emplace_back(tMove);
         }
     }
+}
 
-    // 从大到小排序
-    std::sort(bookMoves.begin(), bookMoves.end(), [](const Move& a, const Move& b) { return a.val > b.val; });
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-
-    int vlSum = 0;
-    for (const Move& move : bookMoves)
+void Search::searchHelper(int id, int maxDepth)
+{
+    // 辅助线程只负责填充置换表, 结果由主线程给出
+    // 奇数号线程从更深一层开始, 错开各线程的搜索深度
+    MovesGen::getMoves(board, rootMoves);
+    for (int depth = 1 + (id & 1); depth <= maxDepth && !stop; depth++)
     {
-        vlSum += move.val;
+        searchRoot(depth);
     }
+}
 
-    if (bookMoves.empty())
+Result Search::searchOpenBook() const
+{
+    if (!useBook || !this->book)
     {
-        pBookFileStruct->close();
         return Result{Move{}, -1};
     }
+    return this->book->pick(board, bannedMoves);
+}
 
-    std::uniform_int_distribution<> dis(0, vlSum - 1);
-    int vlRandom = dis(gen);
+Result Search::searchRoot(int depth, int alpha, int beta, size_t firstMove)
+{
+    Move bestMove{};
+    int vl = -INF;
+    int vlBest = -INF;
+    const int alphaOrigin = alpha;
 
-    Move bookMove;
-    for (const Move& move : bookMoves)
+    // 上一次迭代的主要变例着法放在最前面
+    // 多主要变例时只搜索 firstMove 之后的着法, 之前的着法已经是更好的变例
+    const Move pvMove = this->pv->previous(0);
+    for (size_t i = firstMove + 1; i < rootMoves.size(); i++)
     {
-        vlRandom -= move.val;
-        if (vlRandom < 0)
+        if (rootMoves[i] == pvMove)
         {
-            bookMove = move;
+            std::rotate(rootMoves.begin() + firstMove, rootMoves.begin() + i, rootMoves.begin() + i + 1);
             break;
         }
     }
+    this->pv->clear(0);
 
-    pBookFileStruct->close();
-
-    bookMove.attacker = board.piecePosition(bookMove.x1, bookMove.y1);
-    bookMove.captured = board.piecePosition(bookMove.x2, bookMove.y2);
-
-    if (bannedMoves.find(bookMove.id) != bannedMoves.end())
-    {
-        return Result{Move{}, -1};
-    }
-
-    return Result{bookMove, 1};
-}
-
-Result Search::searchRoot(int depth)
-{
-    Move bestMove{};
-    int vl = -INF;
-    int vlBest = -INF;
+    // 记录每个根节点着法的分值和子树节点数, 用于下一次迭代排序
+    std::array<int, MAX_MOVELIST_SIZE> vlRoot{};
+    std::array<uint64, MAX_MOVELIST_SIZE> nodesRoot{};
+    vlRoot.fill(-INF);
 
-    for (const Move& move : rootMoves)
+    for (size_t i = firstMove; i < rootMoves.size(); i++)
     {
         if (stop)
         {
             break;
         }
+        const Move move = rootMoves[i];
+        const uint64 nodesBefore = this->stats.totalNodes();
+        this->followPv = move == pvMove;
+        this->pv->clear(1);
         board.doMove(move);
         if (vlBest == -INF)
         {
-            vl = -searchPV(depth - 1, -INF, -vlBest);
+            vl = -searchPV(depth - 1, -beta, -alpha);
         }
         else
         {
-            vl = -searchCut(depth - 1, -vlBest);
-            if (vl > vlBest)
+            vl = -searchCut(depth - 1, -alpha);
+            if (vl > alpha && vl < beta)
             {
-                vl = -searchPV(depth - 1, -INF, -vlBest);
+                vl = -searchPV(depth - 1, -beta, -alpha);
             }
         }
-        if (vl > vlBest && bannedMoves.find(move.id) == bannedMoves.end())
+        this->followPv = false;
+        board.undoMove();
+        vlRoot[i] = vl;
+        nodesRoot[i] = this->stats.totalNodes() - nodesBefore;
+
+        if (vl > vlBest && bannedMoves.find(move.id()) == bannedMoves.end())
         {
             vlBest = vl;
             bestMove = move;
+            if (vl > alpha)
+            {
+                alpha = vl;
+                this->pv->update(0, move);
+            }
+            if (vl >= beta)
+            {
+                break;
+            }
         }
+    }
 
-        board.undoMove();
+    if (stop)
+    {
+        return Result{bestMove, vlBest};
     }
 
-    if (bestMove.id == -1)
+    if (bestMove.id() == -1)
     {
         vlBest += board.distance;
     }
-    else
+    else if (vlBest > alphaOrigin)
+    {
+        // 窗口外的结果只是边界, 低出窗口时最佳着法也不可信
+        this->history->add(board, bestMove, depth);
+        this->tt->set(board, bestMove, vlBest, vlBest >= beta ? BETA_TYPE : EXACT_TYPE, depth);
+        SearchStats::inc(this->stats.ttStores);
+    }
+
+    // 根节点着法按上一次迭代的分值排序, 分值相同时子树节点数多的在前
+    std::array<size_t, MAX_MOVELIST_SIZE> order{};
+    for (size_t i = firstMove; i < rootMoves.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin() + firstMove, order.begin() + rootMoves.size(), [&](size_t a, size_t b) {
+        return vlRoot[a] != vlRoot[b] ? vlRoot[a] > vlRoot[b] : nodesRoot[a] > nodesRoot[b];
+    });
+    std::array<Move, MAX_MOVELIST_SIZE> sorted{};
+    for (size_t i = firstMove; i < rootMoves.size(); i++)
+    {
+        sorted[i] = rootMoves[order[i]];
+    }
+    std::copy(sorted.begin() + firstMove, sorted.begin() + rootMoves.size(), rootMoves.begin() + firstMove);
+    // 被禁止的着法分值可能更高, 最佳着法总是放在最前面, 多主要变例依靠这一点排除已选出的着法
+    for (size_t i = firstMove + 1; i < rootMoves.size() && bestMove.id() != -1; i++)
     {
-        this->history->add(bestMove, depth);
-        this->tt->set(board, bestMove, vlBest, EXACT_TYPE, depth);
+        if (rootMoves[i] == bestMove)
+        {
+            std::rotate(rootMoves.begin() + firstMove, rootMoves.begin() + i, rootMoves.begin() + i + 1);
+            break;
+        }
     }
 
-    this->history->sort(rootMoves);
+    if (vlBest > alphaOrigin)
+    {
+        this->pv->save();
+    }
 
     return Result{bestMove, vlBest};
 }
 
 int Search::searchPV(int depth, int alpha, int beta)
 {
+    if (stop)
+    {
+        return 0;
+    }
+    SearchStats::inc(this->stats.nodes);
+    this->stats.updateSeldepth(board.distance);
+    this->pollTime();
+    this->pv->clear(board.distance);
+    const bool onPv = this->followPv;
+    this->followPv = false;
+
     if (!board.isKingLive(board.team))
     {
         return -INF + board.distance;
@@ -493,142 +701,101 @@ int Search::searchPV(int depth, int alpha, int beta)
     int vlBest = -INF;
     Move bestMove{};
     NODE_TYPE type = ALPHA_TYPE;
-    const bool mChecking = board.inCheck(board.team);
-    if (mChecking && !board.historyMoves.empty())
+    // 将军信息缓存在撤销栈上, 同时标记上一步为将军着法
+    const bool mChecking = board.isChecked();
+
+    // 重复检测
+    if (board.isRepeated())
+    {
+        return INF;
+    }
+
+    // 沿上一次迭代的主要变例搜索时, 先搜主要变例着法
+    Move pvMove = onPv ? this->pv->previous(board.distance) : Move{};
+    if (pvMove.id() != -1 && !board.isValidMoveInSituation(pvMove))
     {
-        board.historyMoves.back().isCheckingMove = true;
+        pvMove = Move{};
     }
 
-    // 置换表着法
+    // 其次是置换表着法, 都没有时用内部迭代加深得到
     Move goodMove = this->tt->getMove(board);
-    if (goodMove.id == -1 && depth >= 2)
+    if (goodMove.id() != -1)
+    {
+        SearchStats::inc(this->stats.ttHits);
+    }
+    if (pvMove.id() != -1)
+    {
+        goodMove = pvMove;
+    }
+    else if (goodMove.id() == -1 && depth >= 2)
     {
         if (searchPV(depth / 2, alpha, beta) <= alpha)
         {
             searchPV(depth / 2, -INF, beta);
         }
         goodMove = this->tt->getMove(board);
-    }
-    if (goodMove.id != -1)
-    {
-        board.doMove(goodMove);
-        vlBest = -searchPV(depth - 1, -beta, -alpha);
-        board.undoMove();
-        bestMove = goodMove;
-        if (vlBest >= beta)
-        {
-            type = BETA_TYPE;
-        }
-        if (vlBest > alpha)
-        {
-            type = EXACT_TYPE;
-            alpha = vlBest;
-        }
+        this->pv->clear(board.distance);
     }
 
-    // 杀手启发
-    if (type != BETA_TYPE)
+    // 搜索
+    MovePicker picker(board, *this->history, *this->killer, goodMove, mChecking);
+    for (Move move = picker.next(); move.id() != -1; move = picker.next())
     {
         int vl = -INF;
-        MOVES killerAvailableMoves = this->killer->get(board);
+        this->pv->clear(board.distance + 1);
+        board.doMove(move);
 
-        for (const Move& move : killerAvailableMoves)
+        if (vlBest == -INF)
         {
-            board.doMove(move);
-
-            if (vlBest == -INF)
+            this->followPv = onPv && move == pvMove;
+            vl = -searchPV(depth - 1, -beta, -alpha);
+            this->followPv = false;
+        }
+        else
+        {
+            vl = -searchCut(depth - 1, -alpha);
+            if (vl > alpha && vl < beta)
             {
                 vl = -searchPV(depth - 1, -beta, -alpha);
             }
-            else
-            {
-                vl = -searchCut(depth - 1, -alpha);
-                if (vl > alpha && vl < beta)
-                {
-                    vl = -searchPV(depth - 1, -beta, -alpha);
-                }
-            }
-
-            board.undoMove();
-
-            if (vl > vlBest)
-            {
-                vlBest = vl;
-                bestMove = move;
-                if (vl >= beta)
-                {
-                    type = BETA_TYPE;
-                    break;
-                }
-                if (vl > alpha)
-                {
-                    type = EXACT_TYPE;
-                    alpha = vl;
-                }
-            }
         }
-    }
-
-    // 重复检测
-    if (board.isRepeated())
-    {
-        return INF;
-    }
-
-    // 搜索
-    if (type != BETA_TYPE)
-    {
-        int vl = -INF;
-        MOVES availableMoves = MovesGen::getMoves(board);
 
-        this->history->sort(availableMoves);
+        board.undoMove();
 
-        for (const Move& move : availableMoves)
+        if (vl > vlBest)
         {
-            board.doMove(move);
-
-            if (vlBest == -INF)
-            {
-                vl = -searchPV(depth - 1, -beta, -alpha);
-            }
-            else
+            vlBest = vl;
+            bestMove = move;
+            if (vl >= beta)
             {
-                vl = -searchCut(depth - 1, -alpha);
-                if (vl > alpha && vl < beta)
-                {
-                    vl = -searchPV(depth - 1, -beta, -alpha);
-                }
+                type = BETA_TYPE;
+                break;
             }
-
-            board.undoMove();
-
-            if (vl > vlBest)
+            if (vl > alpha)
             {
-                vlBest = vl;
-                bestMove = move;
-                if (vl >= beta)
-                {
-                    type = BETA_TYPE;
-                    break;
-                }
-                if (vl > alpha)
-                {
-                    type = EXACT_TYPE;
-                    alpha = vl;
-                }
+                type = EXACT_TYPE;
+                alpha = vl;
+                this->pv->update(board.distance, move);
             }
         }
     }
 
+    // 被中止的搜索结果不可信, 不写入置换表
+    if (stop)
+    {
+        return vlBest;
+    }
+
     // 结果
-    if (bestMove.id == -1)
+    if (bestMove.id() == -1)
     {
         vlBest += board.distance;
     }
     else
     {
-        this->history->add(bestMove, depth);
+        this->history->add(board, bestMove, depth);
         this->tt->set(board, bestMove, vlBest, type, depth);
+        SearchStats::inc(this->stats.ttStores);
         if (type != ALPHA_TYPE)
         {
             this->killer->set(board, bestMove);
@@ -640,6 +807,14 @@ int Search::searchPV(int depth, int alpha, int beta)
 
 int Search::searchCut(int depth, int beta, bool banNullMove)
 {
+    if (stop)
+    {
+        return 0;
+    }
+    SearchStats::inc(this->stats.nodes);
+    this->stats.updateSeldepth(board.distance);
+    this->pollTime();
+
     if (!board.isKingLive(board.team))
     {
         return -INF + board.distance;
@@ -655,6 +830,7 @@ int Search::searchCut(int depth, int beta, bool banNullMove)
     int vlHash = this->tt->getVl(board, -INF, beta, depth);
     if (vlHash >= beta)
     {
+        SearchStats::inc(this->stats.ttHits);
         return vlHash;
     }
 
@@ -668,11 +844,8 @@ int Search::searchCut(int depth, int beta, bool banNullMove)
     int vlBest = -INF;
     Move bestMove{};
     NODE_TYPE type = ALPHA_TYPE;
-    const bool mChecking = board.inCheck(board.team);
-    if (mChecking && !board.historyMoves.empty())
-    {
-        board.historyMoves.back().isCheckingMove = true;
-    }
+    // 将军信息缓存在撤销栈上, 同时标记上一步为将军着法
+    const bool mChecking = board.isChecked();
 
     if (!mChecking)
     {
@@ -699,50 +872,6 @@ int Search::searchCut(int depth, int beta, bool banNullMove)
         }
     }
 
-    // 置换表着法
-    Move goodMove = this->tt->getMove(board);
-    if (goodMove.id != -1)
-    {
-        board.doMove(goodMove);
-        int vl = -searchCut(depth - 1, -beta + 1);
-        board.undoMove();
-        bestMove = goodMove;
-        if (vl > vlBest)
-        {
-            vlBest = vl;
-            if (vl >= beta)
-            {
-                type = BETA_TYPE;
-            }
-        }
-    }
-
-    // 杀手启发
-    if (type != BETA_TYPE)
-    {
-        int vl = -INF;
-        MOVES killerAvailableMoves = this->killer->get(board);
-        for (const Move& move : killerAvailableMoves)
-        {
-            board.doMove(move);
-
-            int vl = -searchCut(depth - 1, -beta + 1);
-
-            board.undoMove();
-
-            if (vl > vlBest)
-            {
-                vlBest = vl;
-                bestMove = move;
-                if (vl >= beta)
-                {
-                    type = BETA_TYPE;
-                    break;
-                }
-            }
-        }
-    }
-
     // 重复检测
     if (board.isRepeated())
     {
@@ -750,42 +879,48 @@ int Search::searchCut(int depth, int beta, bool banNullMove)
     }
 
     // 搜索
-    if (type != BETA_TYPE)
+    const Move hashMove = this->tt->getMove(board);
+    if (hashMove.id() != -1)
     {
-        MOVES availableMoves = MovesGen::getMoves(board);
-
-        this->history->sort(availableMoves);
-
-        for (const Move& move : availableMoves)
-        {
-            board.doMove(move);
+        SearchStats::inc(this->stats.ttHits);
+    }
+    MovePicker picker(board, *this->history, *this->killer, hashMove, mChecking);
+    for (Move move = picker.next(); move.id() != -1; move = picker.next())
+    {
+        board.doMove(move);
 
-            int vl = -searchCut(depth - 1, -beta + 1);
+        int vl = -searchCut(depth - 1, -beta + 1);
 
-            board.undoMove();
+        board.undoMove();
 
-            if (vl > vlBest)
+        if (vl > vlBest)
+        {
+            vlBest = vl;
+            bestMove = move;
+            if (vl >= beta)
             {
-                vlBest = vl;
-                bestMove = move;
-                if (vl >= beta)
-                {
-                    type = BETA_TYPE;
-                    break;
-                }
+                type = BETA_TYPE;
+                break;
             }
         }
     }
 
+    // 被中止的搜索结果不可信, 不写入置换表
+    if (stop)
+    {
+        return vlBest;
+    }
+
     // 结果
-    if (bestMove.id == -1)
+    if (bestMove.id() == -1)
     {
         vlBest += board.distance;
     }
     else
     {
-        this->history->add(bestMove, depth);
+        this->history->add(board, bestMove, depth);
         this->tt->set(board, bestMove, vlBest, type, depth);
+        SearchStats::inc(this->stats.ttStores);
         if (type != ALPHA_TYPE)
         {
             this->killer->set(board, bestMove);
@@ -797,6 +932,13 @@ int Search::searchCut(int depth, int beta, bool banNullMove)
 
 int Search::searchQ(int alpha, int beta, int leftDistance)
 {
+    if (stop)
+    {
+        return 0;
+    }
+    SearchStats::inc(this->stats.qnodes);
+    this->stats.updateSeldepth(board.distance);
+    this->pollTime();
     if (!board.isKingLive(board.team))
     {
         return -INF + board.distance;
@@ -817,10 +959,9 @@ int Search::searchQ(int alpha, int beta, int leftDistance)
 
     int vlBest = -INF;
     Move bestMove{};
-    const bool mChecking = board.inCheck(board.team);
-    if (mChecking && !board.historyMoves.empty())
+    const bool mChecking = board.isChecked();
+    if (mChecking)
     {
-        board.historyMoves.back().isCheckingMove = true;
         leftDistance = std::min<int>(leftDistance, this->Q_DEPTH_CHECKING);
     }
 
@@ -840,10 +981,9 @@ int Search::searchQ(int alpha, int beta, int leftDistance)
         return INF;
     }
 
-    // 搜索
-    MOVES availableMoves = mChecking ? MovesGen::getMoves(board) : MovesGen::getCaptureMoves(board);
-    this->history->sort(availableMoves);
-    for (const Move& move : availableMoves)
+    // 搜索, 没有被将军时只搜索吃子着法
+    MovePicker picker(board, *this->history, *this->killer, Move{}, mChecking, !mChecking);
+    for (Move move = picker.next(); move.id() != -1; move = picker.next())
     {
         board.doMove(move);
 
@@ -0,0 +1,156 @@
+﻿#pragma once
+#include "base.hpp"
+
+// 时间限制, 对应 go 指令的参数, 单位均为毫秒, 0 表示没有给出
+class TimeLimits
+{
+public:
+    TimeLimits() = default;
+
+public:
+    int64_t time = 0;
+    int64_t increment = 0;
+    int64_t opptime = 0;
+    int64_t oppincrement = 0;
+    int movestogo = 0;
+    int64_t movetime = 0;
+    bool infinite = false;
+
+public:
+    // 固定每步用时
+    static TimeLimits fixed(int64_t movetime)
+    {
+        TimeLimits limits{};
+        limits.movetime = movetime;
+        return limits;
+    }
+};
+
+// 时间管理
+// 软限制决定是否开始下一次迭代, 根据分值下降和最佳着法变化伸缩
+// 硬限制在搜索过程中定期检查, 到时立即中止搜索
+// 后台思考时不受时间限制, ponderhit 之后按照从 go 开始计算的正常用时继续
+class TimeManager
+{
+public:
+    TimeManager() = default;
+    TimeManager(const TimeManager&) = delete;
+    TimeManager& operator=(const TimeManager&) = delete;
+
+protected:
+    std::chrono::steady_clock::time_point startTime{};
+    int64_t optimumMs = 0;
+    int64_t maximumMs = 0;
+    bool limited = false;
+    int64_t softLimitMs = 0;
+    // 只有这两个标志会被 UCCI 线程改写, 其余成员都只在搜索线程读写
+    std::atomic<bool> pondering{false};
+    std::atomic<bool> ponderhitPending{false};
+
+    // 迭代之间的稳定性统计
+    int lastVl = 0;
+    Move lastMove{};
+    double bestMoveChanges = 0;
+    double scale = 1.0;
+
+protected:
+    // 为网络和界面延迟预留的时间
+    const int64_t MOVE_OVERHEAD = 50;
+    // 没有给出 movestogo 时按剩余步数估计
+    const int DEFAULT_MOVES_TO_GO = 30;
+    const int MAX_MOVES_TO_GO = 50;
+    const int64_t MIN_THINK_MS = 10;
+
+public:
+    void start(const TimeLimits& limits)
+    {
+        this->startTime = std::chrono::steady_clock::now();
+        this->lastVl = 0;
+        this->lastMove = Move{};
+        this->bestMoveChanges = 0;
+        this->scale = 1.0;
+        this->limited = !limits.infinite && (limits.movetime > 0 || limits.time > 0);
+        if (!this->limited)
+        {
+            this->optimumMs = std::numeric_limits<int64_t>::max();
+            this->maximumMs = std::numeric_limits<int64_t>::max();
+        }
+        else if (limits.movetime > 0)
+        {
+            // 固定用时: 用到三分之一后不再开始新的迭代, 到时强制停止
+            this->optimumMs = std::max<int64_t>(limits.movetime / 3, 1);
+            this->maximumMs = std::max<int64_t>(limits.movetime, 1);
+        }
+        else
+        {
+            // 时段制和加秒制: 剩余时间平均分给剩余步数, 加秒大部分用掉
+            const int movesToGo = limits.movestogo > 0 ? std::min(limits.movestogo, this->MAX_MOVES_TO_GO) : this->DEFAULT_MOVES_TO_GO;
+            const int64_t available = std::max<int64_t>(limits.time - this->MOVE_OVERHEAD, this->MIN_THINK_MS);
+            const int64_t optimum = available / movesToGo + limits.increment * 3 / 4;
+            // 最后一步前必须留出时间, 硬限制不超过剩余时间的一定比例
+            const int64_t ceiling = movesToGo == 1 ? available : available * 3 / 4;
+            this->optimumMs = std::max<int64_t>(std::min<int64_t>(optimum, ceiling), this->MIN_THINK_MS);
+            this->maximumMs = std::max<int64_t>(std::min<int64_t>(optimum * 4, ceiling), this->optimumMs);
+        }
+        this->softLimitMs = this->optimumMs;
+    }
+
+    int64_t elapsed() const
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - this->startTime).count();
+    }
+
+    bool hardExpired() const { return this->limited && !this->pondering && this->elapsed() >= this->maximumMs; }
+
+    // 后台思考标志在搜索开始前设置, 不随 start 重置, 避免搜索线程启动前到达的 ponderhit 丢失
+    void setPondering(bool ponder)
+    {
+        this->pondering = ponder;
+        this->ponderhitPending = false;
+    }
+
+    // 对方走了预想的着法, 转为正常计时
+    // 由 UCCI 线程调用, 只改写标志, 是否已经用完软限制留给搜索线程判断
+    void ponderhit()
+    {
+        this->pondering = false;
+        this->ponderhitPending = true;
+    }
+
+    // 由搜索线程定期调用, ponderhit 之后只检查一次, 后台思考期间已经用完软限制时返回 true
+    bool ponderhitExpired()
+    {
+        if (!this->ponderhitPending.load(std::memory_order_relaxed) || !this->ponderhitPending.exchange(false))
+        {
+            return false;
+        }
+        return this->limited && this->elapsed() >= this->softLimitMs;
+    }
+
+    // 一次迭代完成后调用, 返回是否还有时间开始下一次迭代
+    bool nextIteration(int depth, int vl, Move bestMove)
+    {
+        if (!this->limited)
+        {
+            return true;
+        }
+        // 最佳着法变化越频繁, 分值下降越多, 越需要多想一会
+        // 后台思考时也照常统计, ponderhit 之后用得上
+        this->bestMoveChanges /= 2;
+        if (depth > 1 && bestMove != this->lastMove)
+        {
+            this->bestMoveChanges += 1;
+        }
+        double dropFactor = 1.0;
+        if (depth > 1 && vl < this->lastVl)
+        {
+            dropFactor += std::min<double>(this->lastVl - vl, 200) / 200;
+        }
+        this->scale = std::min<double>((1.0 + this->bestMoveChanges / 2) * dropFactor, 2.5);
+        this->lastVl = vl;
+        this->lastMove = bestMove;
+
+        this->softLimitMs = std::min<int64_t>(int64_t(double(this->optimumMs) * this->scale), this->maximumMs);
+        return this->pondering || this->elapsed() < this->softLimitMs;
+    }
+};
@@ -1,4 +1,6 @@
 #include "search.hpp"
+#include "perft.hpp"
+#include "bench.hpp"
 
 class UCCI
 {
@@ -7,6 +9,9 @@ public:
     {
         std::string defaultFen = "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1";
         this->search = std::make_unique<Search>(fenToPieceidmap(defaultFen), RED);
+        this->search->tt = this->tt;
+        this->hashMb = this->appliedHashMb = this->tt->sizeMb();
+        this->searchThread = std::thread([this]() { this->searchLoop(); });
         cli();
     };
 
@@ -19,31 +24,48 @@ public:
     void setoption(const std::string& name, const std::string& value);
     void position(const std::string& fenCode, const MOVES& moves);
     void banmoves(const MOVES& moves);
-    void go(int time, int depth);
+    void go(const TimeLimits& limits, int depth, bool ponder = false);
+    void ponderhit();
+    void perft(int depth, bool divide);
     void stop();
     void quit();
 
+protected:
+    void searchLoop();
+    void applyHash();
+
 public:
     std::unique_ptr<Search> search = nullptr;
     int maxTime = 3000;
     int maxDepth = 20;
+    bool useBook = true;
+    bool useMillisec = false;
+    int threads = 1;
+    int multiPV = 1;
+    // 置换表大小(MB), 搜索中收到的设置在下一次 go 之前生效
+    int hashMb = 0;
+    int appliedHashMb = 0;
+    std::shared_ptr<Tt> tt = std::make_shared<Tt>();
     bool ready = false;
-    bool searchCompleted = true;
     Result searchResult{};
+
+protected:
+    // 常驻的搜索线程, 由 go 唤醒, 搜索结束后由它输出 bestmove
     std::thread searchThread{};
+    std::mutex searchMutex{};
+    std::condition_variable searchCv{};
+    std::atomic<bool> searching{false};
+    // 后台思考中, 搜索完成也要等到 ponderhit 或 stop 才输出 bestmove
+    bool pondering = false;
+    bool searchRequested = false;
+    bool quitting = false;
+    TimeLimits searchLimits{};
+    int searchDepth = 0;
 
 public:
     std::string fen() const { return pieceidmapToFen(search->board.pieceidMap, search->board.team); }
     MOVES history() const { return search->board.historyMoves; }
-    std::string convertToUCCIMove(Move move) const
-    {
-        std::string ret = "";
-        ret += char('a' + move.x1);
-        ret += char('0' + move.y1);
-        ret += char('a' + move.x2);
-        ret += char('0' + move.y2);
-        return ret;
-    }
+    std::string convertToUCCIMove(Move move) const { return moveToUcci(move); }
     Move convertToEngineMove(std::string movestr) const
     {
         int x1 = movestr[0] - 'a';
@@ -96,30 +118,47 @@ void UCCI::cli()
         }
         else if (cmd.substr(0, 9) == "setoption")
         {
+            // setoption [name] <option> [value <value>], 缺少部分时按空值处理
             size_t name_pos = cmd.find("name");
             size_t value_pos = cmd.find("value");
-            std::string name = cmd.substr(name_pos + 5, value_pos - name_pos - 6);
-            std::string value = cmd.substr(value_pos + 6);
+            size_t name_start = name_pos == std::string::npos ? 10 : name_pos + 5;
+            size_t name_end = value_pos == std::string::npos ? cmd.size() : value_pos;
+            std::string name = name_start < name_end ? cmd.substr(name_start, name_end - name_start) : "";
+            name.erase(name.find_last_not_of(' ') + 1);
+            std::string value = value_pos == std::string::npos || value_pos + 6 > cmd.size() ? "" : cmd.substr(value_pos + 6);
             setoption(name, value);
         }
         else if (cmd == "quit")
         {
             quit();
         }
-        if (!searchCompleted) // 搜索中才可以进行的指令
+        if (cmd == "stop")
         {
-            if (cmd == "stop")
-            {
-                stop();
-            }
+            stop();
         }
-        else // 没有进入搜索状态才可以进行的指令
+        else if (cmd.substr(0, 9) == "ponderhit")
         {
+            ponderhit();
+        }
+        else // 没有进入搜索状态才可以进行的指令, 搜索中收到时先停止当前搜索
+        {
+            const std::vector<std::string> idleCommands = {"go", "position fen", "banmoves", "perft", "divide", "bench"};
+            for (const std::string& prefix : idleCommands)
+            {
+                if (searching && cmd.substr(0, prefix.size()) == prefix)
+                {
+                    stop();
+                    break;
+                }
+            }
             if (cmd.substr(0, 2) == "go")
             {
-                // AI 生成的一个movetime和depth解析的代码
-                int timeArg = maxTime;
+                // go [ponder] [depth d] [movetime t] [time t [increment i] [opptime t [oppincrement i]] [movestogo n]] [infinite]
+                // time, increment, opptime, oppincrement 默认以秒为单位, 设置 usemillisec 后以毫秒为单位
+                TimeLimits limits{};
                 int depthArg = maxDepth;
+                bool timeGiven = false;
+                bool ponder = false;
 
                 size_t pos = 2;
                 auto nextToken = [&](size_t& p) -> std::string {
@@ -130,30 +169,64 @@ void UCCI::cli()
                     p = (q == std::string::npos) ? std::string::npos : q + 1;
                     return tok;
                 };
+                // 不合法的数值按没有给出处理
+                auto nextValue = [&](size_t& p) -> int64_t {
+                    int64_t val = 0;
+                    return parseInt(nextToken(p), val) ? std::max<int64_t>(val, 0) : 0;
+                };
+                const int64_t unit = useMillisec ? 1 : 1000;
 
                 std::string token = nextToken(pos);
                 while (!token.empty())
                 {
                     if (token == "depth")
                     {
-                        std::string val = nextToken(pos);
-                        if (!val.empty())
-                        {
-                            depthArg = std::stoi(val);
-                        }
+                        const int64_t d = nextValue(pos);
+                        depthArg = d > 0 ? int(std::min<int64_t>(d, ENGINE_MAX_DEPTH - 1)) : depthArg;
                     }
                     else if (token == "movetime")
                     {
-                        std::string val = nextToken(pos);
-                        if (!val.empty())
-                        {
-                            timeArg = std::stoi(val);
-                        }
+                        limits.movetime = nextValue(pos);
+                        timeGiven = true;
+                    }
+                    else if (token == "time")
+                    {
+                        limits.time = nextValue(pos) * unit;
+                        timeGiven = true;
+                    }
+                    else if (token == "increment")
+                    {
+                        limits.increment = nextValue(pos) * unit;
+                    }
+                    else if (token == "opptime")
+                    {
+                        limits.opptime = nextValue(pos) * unit;
+                    }
+                    else if (token == "oppincrement")
+                    {
+                        limits.oppincrement = nextValue(pos) * unit;
+                    }
+                    else if (token == "movestogo")
+                    {
+                        limits.movestogo = int(nextValue(pos));
+                    }
+                    else if (token == "ponder")
+                    {
+                        ponder = true;
+                    }
+                    else if (token == "infinite")
+                    {
+                        limits.infinite = true;
+                        timeGiven = true;
                     }
                     token = nextToken(pos);
                 }
+                if (!timeGiven)
+                {
+                    limits.movetime = maxTime;
+                }
 
-                go(timeArg, depthArg);
+                go(limits, depthArg, ponder);
             }
             else if (cmd.substr(0, 12) == "position fen")
             {
@@ -182,6 +255,35 @@ void UCCI::cli()
                 MOVES moveList = parseMovesInput(moves);
                 banmoves(moveList);
             }
+            else if (cmd.substr(0, 5) == "perft" || cmd.substr(0, 6) == "divide")
+            {
+                bool divide = cmd.substr(0, 6) == "divide";
+                std::string val = cmd.substr(divide ? 6 : 5);
+                int64_t depth = 1;
+                if (!parseInt(val, depth))
+                {
+                    depth = 1;
+                }
+                perft(int(std::min<int64_t>(depth, ENGINE_MAX_DEPTH)), divide);
+            }
+            else if (cmd.substr(0, 5) == "bench")
+            {
+                // bench [depth] [threads] [hashMB]
+                // 缺少或不合法的参数使用默认值
+                std::vector<int> args{7, 1, 16};
+                const std::vector<int64_t> maxArgs{ENGINE_MAX_DEPTH - 1, MAX_THREADS, MAX_HASH_MB};
+                std::istringstream stream(cmd.substr(5));
+                std::string token;
+                for (size_t i = 0; i < args.size() && stream >> token; i++)
+                {
+                    int64_t value = 0;
+                    if (parseInt(token, value) && value > 0)
+                    {
+                        args[i] = int(std::min<int64_t>(value, maxArgs[i]));
+                    }
+                }
+                Bench::run(args[0], args[1], args[2]);
+            }
         }
     }
 }
@@ -201,13 +303,59 @@ void UCCI::isready() const
 // setoption my_option_name my_option_value
 void UCCI::setoption(const std::string& name, const std::string& value)
 {
-    if (name == "usebook")
+    std::string option = name;
+    std::transform(option.begin(), option.end(), option.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    if (option == "usebook")
     {
-        search->useBook = (value == "true" || value == "1");
+        useBook = (value == "true" || value == "1");
+        // 启动时没有找到开局库文件的话, 开启时再尝试映射一次
+        if (useBook && !searching && !search->book->isOpen())
+        {
+            search->book->open(OpenBook::DEFAULT_PATH);
+        }
     }
-    else if (name == "usemillisec")
+    else if (option == "threads")
     {
-        return;
+        // 线程数在下一次 go 时生效, 非法的值忽略
+        int64_t n = 0;
+        if (parseInt(value, n))
+        {
+            threads = int(std::max<int64_t>(1, std::min<int64_t>(n, MAX_THREADS)));
+        }
+    }
+    else if (option == "multipv")
+    {
+        // 变例数在下一次 go 时生效, 届时再限制在根节点的合法着法数以内
+        int64_t n = 0;
+        if (parseInt(value, n))
+        {
+            multiPV = int(std::max<int64_t>(1, std::min<int64_t>(n, MAX_MOVELIST_SIZE)));
+        }
+    }
+    else if (option == "hash")
+    {
+        int64_t mb = 0;
+        if (parseInt(value, mb))
+        {
+            hashMb = int(std::max<int64_t>(1, std::min<int64_t>(mb, MAX_HASH_MB)));
+            // 搜索中不能释放置换表, 留到下一次 go
+            if (!searching)
+            {
+                applyHash();
+            }
+        }
+    }
+    else if (option == "newgame")
+    {
+        // 新对局才清空置换表, 同一对局内的搜索结果会被后续着法复用
+        if (!searching)
+        {
+            tt->reset();
+        }
+    }
+    else if (option == "usemillisec")
+    {
+        useMillisec = (value == "true" || value == "1");
     }
 }
 
@@ -216,7 +364,8 @@ void UCCI::position(const std::string& fenCode, const MOVES& moves)
 {
     PIECEID_MAP pieceidMap = fenToPieceidmap(fenCode);
     TEAM team = (fenCode.find("w") != std::string::npos) ? RED : BLACK;
-    search = std::make_unique<Search>(pieceidMap, team);
+    // 复用搜索对象, 保留辅助线程和历史表
+    search->setBoard(Board(pieceidMap, team));
     for (const Move& move : moves)
     {
         search->board.doMove(move);
@@ -228,43 +377,139 @@ void UCCI::banmoves(const MOVES& moves)
 {
     for (const Move& move : moves)
     {
-        search->bannedMoves[move.id] = 1;
+        search->bannedMoves[move.id()] = 1;
     }
 }
 
 // stop
-void UCCI::go(int time, int depth)
+void UCCI::go(const TimeLimits& limits, int depth, bool ponder)
 {
-    maxTime = time;
-    maxDepth = depth;
-    searchThread = std::thread([&]() {
-        searchCompleted = false;
-        Result result = search->searchMain(maxDepth, maxTime);
-        // 如果search进程没有被强行终止
-        if (!searchCompleted)
+    {
+        std::lock_guard<std::mutex> lock(searchMutex);
+        applyHash();
+        searchDepth = depth;
+        searchLimits = limits;
+        search->useBook = useBook;
+        search->threads = threads;
+        Board board = search->board;
+        MoveList legalMoves;
+        MovesGen::getMoves(board, legalMoves);
+        search->multiPV = std::max<int>(1, std::min<int>(multiPV, int(legalMoves.size())));
+        // 后台思考的局面已经包含预计的对方应着, 置换表和历史表在两次搜索之间保留
+        search->setPondering(ponder);
+        pondering = ponder;
+        searching = true;
+        searchRequested = true;
+    }
+    searchCv.notify_all();
+}
+
+// 调整置换表大小, 只在没有搜索时调用
+void UCCI::applyHash()
+{
+    if (hashMb != appliedHashMb)
+    {
+        tt->resize(hashMb);
+        appliedHashMb = hashMb;
+    }
+}
+
+// 搜索线程
+void UCCI::searchLoop()
+{
+    while (true)
+    {
+        TimeLimits limits{};
+        int depth = 0;
+        {
+            std::unique_lock<std::mutex> lock(searchMutex);
+            searchCv.wait(lock, [this]() { return searchRequested || quitting; });
+            if (quitting)
+            {
+                return;
+            }
+            searchRequested = false;
+            limits = searchLimits;
+            depth = searchDepth;
+        }
+        Result result = search->searchMain(depth, limits);
         {
-            std::cout << "bestmove " << convertToUCCIMove(result.move) << std::endl;
-            searchCompleted = true;
+            // 后台思考提前搜完时, 等到 ponderhit 或 stop
+            std::unique_lock<std::mutex> lock(searchMutex);
+            searchCv.wait(lock, [this]() { return !pondering; });
+        }
+        std::cout << "bestmove " << convertToUCCIMove(result.move);
+        if (search->ponderMove.id() != -1)
+        {
+            std::cout << " ponder " << convertToUCCIMove(search->ponderMove);
+        }
+        std::cout << std::endl;
+        {
+            // 搜索结束后才到达的停止请求在这里作废
+            std::lock_guard<std::mutex> lock(searchMutex);
             searchResult = result;
+            search->stop = false;
+            searching = false;
         }
-    });
-    searchThread.detach();
+        searchCv.notify_all();
+    }
+}
+
+// perft / divide, 统计当前局面的着法生成结果
+void UCCI::perft(int depth, bool divide)
+{
+    Board board = search->board;
+    if (divide)
+    {
+        Perft::divide(board, std::max(depth, 1));
+    }
+    else
+    {
+        Perft::run(board, std::max(depth, 1));
+    }
 }
 
 // stop
 void UCCI::stop()
 {
-    // 强行终止search进程
-    searchCompleted = true;
+    // 通知搜索线程停止, 等它输出 bestmove 后返回
+    std::unique_lock<std::mutex> lock(searchMutex);
+    if (!searching)
+    {
+        return;
+    }
     search->stop = true;
-    // 获取目前搜索到的最佳结果
-    searchResult = search->info.getBestResult();
-    // 输出结果
-    std::cout << "bestmove " << convertToUCCIMove(searchResult.move) << std::endl;
+    pondering = false;
+    searchCv.notify_all();
+    searchCv.wait(lock, [this]() { return !searching; });
+}
+
+// ponderhit
+void UCCI::ponderhit()
+{
+    // 对方走了预想的着法, 后台思考转为正常思考
+    std::lock_guard<std::mutex> lock(searchMutex);
+    if (!searching || !pondering)
+    {
+        return;
+    }
+    pondering = false;
+    search->ponderhit();
+    searchCv.notify_all();
 }
 
 // quit
 void UCCI::quit()
 {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(searchMutex);
+        quitting = true;
+    }
+    searchCv.notify_all();
+    if (searchThread.joinable())
+    {
+        searchThread.join();
+    }
     std::exit(0);
 }
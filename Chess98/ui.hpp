@@ -123,7 +123,7 @@ void setBoardCode(Board& board)
 {
     const BOARD_CODE code = generateCode(board);
     const std::string historyMovesBack =
-        board.historyMoves.size() > 0 ? std::to_string(board.historyMoves.back().id) : "null";
+        board.historyMoves.size() > 0 ? std::to_string(board.historyMoves.back().id()) : "null";
     const std::string jsPutCode = "\
         const http = require('http')\n\
         const options = {\n\
@@ -173,7 +173,7 @@ void ui(TEAM team, bool aiFirst, int maxDepth, int maxTime, std::string fenCode)
             // 人机做出决策
             Result node = s.searchMain(maxDepth, maxTime);
             board.doMove(node.move);
-            if (board.inCheck(board.team)) board.historyMoves.back().isCheckingMove = true;
+            if (board.inCheck(board.team)) board.undoStack.back().isCheckingMove = true;
 
             setBoardCode(board);
             readFile("./_move_.txt", moveFileContent);
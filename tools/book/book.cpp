@@ -0,0 +1,505 @@
+﻿#include "movesgen.hpp"
+#include "book.hpp"
+#include <cstdio>
+#include <queue>
+#include <sstream>
+
+// 开局库生成工具, 输出 Chess98 格式的开局库
+// Chess98Book [-plies N] [-min N] [-mem MB] <output> <input>...
+// 输入文件按扩展名区分:
+// .pgn: PGN 棋谱, 着法使用 ICCS 记法(如 H2-E2 或 h2e2), 可带 FEN 标签
+// 其他: 每行一局, 格式为 [position] [fen] <FEN> [moves <着法>...] <1-0|0-1|1/2-1/2>
+// 先在内存中排序合并, 缓冲区满时写出临时的有序段, 最后多路归并成一个文件
+class BookBuilder
+{
+public:
+    BookBuilder(const std::string& output, int maxPlies, int minGames, int memMb) : maxPlies(maxPlies), minGames(minGames)
+    {
+        // 临时有序段放在输出文件旁边, 名字带上进程号, 同时运行的多个实例不会互相覆盖
+#ifdef _WIN32
+        this->runPrefix = output + "." + std::to_string(GetCurrentProcessId());
+#else
+        this->runPrefix = output + "." + std::to_string(getpid());
+#endif
+        this->capacity = std::max<size_t>(size_t(memMb) * (1 << 20) / sizeof(Item), 1024);
+        this->buffer.reserve(this->capacity);
+    }
+
+public:
+    // 一个局面下的一步着法及其战绩, 胜和负从走这步棋的一方来看
+    struct Item
+    {
+        uint64_t key;
+        uint16_t move;
+        uint32_t win;
+        uint32_t draw;
+        uint32_t loss;
+
+        bool sameAs(const Item& other) const { return key == other.key && move == other.move; }
+        bool operator<(const Item& other) const { return key != other.key ? key < other.key : move < other.move; }
+    };
+
+public:
+    bool readFile(const std::string& path);
+    void addGame(const std::string& fen, const std::vector<std::string>& moves, int result);
+    bool finish(const std::string& output);
+
+public:
+    uint64 games = 0;
+    uint64 skipped = 0;
+    uint64 positions = 0;
+
+protected:
+    int maxPlies = 40;
+    int minGames = 1;
+    size_t capacity = 0;
+    std::vector<Item> buffer{};
+    std::vector<std::string> runs{};
+    std::string runPrefix = "";
+
+protected:
+    void push(const Item& item);
+    void flushRun();
+    void readPgn(std::istream& in);
+    void readLines(std::istream& in);
+    static bool parseMove(std::string text, Move& move);
+    static int parseResult(const std::string& text);
+    static void mergeInto(Item& into, const Item& item);
+};
+
+const std::string START_FEN = "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1";
+const int UNKNOWN_RESULT = 2;
+
+bool BookBuilder::parseMove(std::string text, Move& move)
+{
+    // 接受 h2e2, H2E2 和 H2-E2
+    text.erase(std::remove(text.begin(), text.end(), '-'), text.end());
+    if (text.size() != 4)
+    {
+        return false;
+    }
+    const int x1 = std::tolower(text[0]) - 'a';
+    const int y1 = text[1] - '0';
+    const int x2 = std::tolower(text[2]) - 'a';
+    const int y2 = text[3] - '0';
+    if (x1 < 0 || x1 > 8 || x2 < 0 || x2 > 8 || y1 < 0 || y1 > 9 || y2 < 0 || y2 > 9)
+    {
+        return false;
+    }
+    move = Move(x1, y1, x2, y2);
+    return true;
+}
+
+int BookBuilder::parseResult(const std::string& text)
+{
+    // 红方胜为1, 和棋为0, 黑方胜为-1
+    if (text == "1-0")
+    {
+        return 1;
+    }
+    if (text == "0-1")
+    {
+        return -1;
+    }
+    if (text == "1/2-1/2")
+    {
+        return 0;
+    }
+    return UNKNOWN_RESULT;
+}
+
+void BookBuilder::mergeInto(Item& into, const Item& item)
+{
+    into.win += item.win;
+    into.draw += item.draw;
+    into.loss += item.loss;
+}
+
+void BookBuilder::addGame(const std::string& fen, const std::vector<std::string>& moves, int result)
+{
+    if (result == UNKNOWN_RESULT)
+    {
+        this->skipped++;
+        return;
+    }
+    Board board{fenToPieceidmap(fen), fenToTeam(fen)};
+    this->games++;
+    MoveList legalMoves;
+    for (size_t i = 0; i < moves.size() && int(i) < this->maxPlies; i++)
+    {
+        Move move{};
+        if (!BookBuilder::parseMove(moves[i], move))
+        {
+            break;
+        }
+        // 棋谱中的非法着法之后的局面都不收录
+        legalMoves.clear();
+        MovesGen::getMoves(board, legalMoves);
+        if (std::find(legalMoves.begin(), legalMoves.end(), move) == legalMoves.end())
+        {
+            break;
+        }
+        const int score = result * board.team;
+        this->push(Item{OpenBook::positionKey(board), OpenBook::encodeMove(move), uint32_t(score > 0), uint32_t(score == 0),
+                        uint32_t(score < 0)});
+        board.doMove(move);
+    }
+}
+
+void BookBuilder::push(const Item& item)
+{
+    this->positions++;
+    this->buffer.push_back(item);
+    if (this->buffer.size() >= this->capacity)
+    {
+        this->flushRun();
+    }
+}
+
+void BookBuilder::flushRun()
+{
+    if (this->buffer.empty())
+    {
+        return;
+    }
+    // 排序后合并相同的局面和着法, 写出一个有序段
+    std::sort(this->buffer.begin(), this->buffer.end());
+    size_t n = 0;
+    for (size_t i = 1; i < this->buffer.size(); i++)
+    {
+        if (this->buffer[i].sameAs(this->buffer[n]))
+        {
+            BookBuilder::mergeInto(this->buffer[n], this->buffer[i]);
+        }
+        else
+        {
+            this->buffer[++n] = this->buffer[i];
+        }
+    }
+    this->buffer.resize(n + 1);
+
+    const std::string path = this->runPrefix + ".run" + std::to_string(this->runs.size());
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(this->buffer.data()), std::streamsize(this->buffer.size() * sizeof(Item)));
+    this->runs.push_back(path);
+    this->buffer.clear();
+}
+
+void BookBuilder::readPgn(std::istream& in)
+{
+    std::string fen = START_FEN;
+    int result = UNKNOWN_RESULT;
+    std::vector<std::string> moves{};
+    bool inMoves = false;
+    bool valid = true;
+    int commentDepth = 0;
+    int variationDepth = 0;
+
+    auto endGame = [&]() {
+        if (!moves.empty() || inMoves)
+        {
+            if (valid)
+            {
+                this->addGame(fen, moves, result);
+            }
+            else
+            {
+                this->skipped++;
+            }
+        }
+        fen = START_FEN;
+        result = UNKNOWN_RESULT;
+        moves.clear();
+        inMoves = false;
+        valid = true;
+    };
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (commentDepth == 0 && variationDepth == 0 && !line.empty() && line[0] == '[')
+        {
+            // 标签: 新的标签段意味着上一局结束
+            if (inMoves)
+            {
+                endGame();
+            }
+            const size_t q1 = line.find('"');
+            const size_t q2 = line.rfind('"');
+            if (q1 == std::string::npos || q2 <= q1)
+            {
+                continue;
+            }
+            const std::string name = line.substr(1, line.find_first_of(" \t") - 1);
+            const std::string value = line.substr(q1 + 1, q2 - q1 - 1);
+            if (name == "FEN")
+            {
+                fen = value;
+            }
+            else if (name == "Result")
+            {
+                result = BookBuilder::parseResult(value);
+            }
+            continue;
+        }
+
+        // 着法部分, 跳过注释, 变着和回合数
+        std::string token;
+        for (size_t i = 0; i <= line.size(); i++)
+        {
+            const char c = i < line.size() ? line[i] : ' ';
+            if (commentDepth > 0)
+            {
+                commentDepth -= c == '}';
+                continue;
+            }
+            if (c == '{' || c == '(' || c == ')' || c == ';' || std::isspace(static_cast<unsigned char>(c)))
+            {
+                if (!token.empty() && variationDepth == 0)
+                {
+                    const size_t dot = token.find_last_of('.');
+                    if (dot != std::string::npos)
+                    {
+                        token = token.substr(dot + 1);
+                    }
+                    if (!token.empty())
+                    {
+                        inMoves = true;
+                        const int tokenResult = BookBuilder::parseResult(token);
+                        if (tokenResult != UNKNOWN_RESULT || token == "*")
+                        {
+                            if (result == UNKNOWN_RESULT)
+                            {
+                                result = tokenResult;
+                            }
+                            endGame();
+                        }
+                        else
+                        {
+                            Move move{};
+                            valid = valid && BookBuilder::parseMove(token, move);
+                            moves.push_back(token);
+                        }
+                    }
+                }
+                token.clear();
+                commentDepth += c == '{';
+                variationDepth += (c == '(') - (c == ')' && variationDepth > 0);
+                if (c == ';')
+                {
+                    break;
+                }
+                continue;
+            }
+            token += c;
+        }
+    }
+    endGame();
+}
+
+void BookBuilder::readLines(std::istream& in)
+{
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream stream(line);
+        std::vector<std::string> tokens{};
+        std::string token;
+        while (stream >> token)
+        {
+            tokens.push_back(token);
+        }
+        size_t i = 0;
+        if (i < tokens.size() && tokens[i] == "position")
+        {
+            i++;
+        }
+        if (i < tokens.size() && tokens[i] == "fen")
+        {
+            i++;
+        }
+        if (i + 1 >= tokens.size())
+        {
+            continue;
+        }
+        // 最后一个词是结果, moves 之前是 FEN
+        const int result = BookBuilder::parseResult(tokens.back());
+        std::string fen = "";
+        for (; i + 1 < tokens.size() && tokens[i] != "moves"; i++)
+        {
+            fen += (fen.empty() ? "" : " ") + tokens[i];
+        }
+        if (fen == "startpos")
+        {
+            fen = START_FEN;
+        }
+        const std::vector<std::string> moves(tokens.begin() + std::ptrdiff_t(std::min(i + 1, tokens.size() - 1)), tokens.end() - 1);
+        this->addGame(fen, moves, result);
+    }
+}
+
+bool BookBuilder::readFile(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        std::cout << "cannot open " << path << std::endl;
+        return false;
+    }
+    std::string ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    try
+    {
+        if (ext == ".pgn")
+        {
+            this->readPgn(file);
+        }
+        else
+        {
+            this->readLines(file);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        // 无法解析的 FEN
+        std::cout << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool BookBuilder::finish(const std::string& output)
+{
+    this->flushRun();
+
+    std::ofstream out(output, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cout << "cannot write " << output << std::endl;
+        return false;
+    }
+    OpenBook::Header header{};
+    std::memcpy(header.magic, OpenBook::MAGIC, sizeof(header.magic));
+    header.version = OpenBook::VERSION;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // 多路归并各有序段
+    struct Cursor
+    {
+        Item item;
+        size_t run;
+        bool operator>(const Cursor& other) const { return other.item < item; }
+    };
+    std::vector<std::ifstream> files{};
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heap{};
+    auto advance = [&files, &heap](size_t run) {
+        Item item{};
+        if (files[run].read(reinterpret_cast<char*>(&item), sizeof(Item)))
+        {
+            heap.push(Cursor{item, run});
+        }
+    };
+    for (size_t run = 0; run < this->runs.size(); run++)
+    {
+        files.emplace_back(this->runs[run], std::ios::in | std::ios::binary);
+    }
+    for (size_t run = 0; run < this->runs.size(); run++)
+    {
+        advance(run);
+    }
+
+    uint32_t count = 0;
+    auto emit = [this, &out, &count](const Item& item) {
+        const uint32_t total = item.win + item.draw + item.loss;
+        if (total < uint32_t(this->minGames))
+        {
+            return;
+        }
+        // 超过16位时等比例缩小
+        const uint32_t largest = std::max<uint32_t>({item.win, item.draw, item.loss});
+        const uint32_t divisor = (largest + 0xFFFF) / 0xFFFF;
+        const OpenBook::Entry entry{item.key, item.move, uint16_t(item.win / divisor), uint16_t(item.draw / divisor),
+                                    uint16_t(item.loss / divisor)};
+        out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        count++;
+    };
+    bool hasCurrent = false;
+    Item current{};
+    while (!heap.empty())
+    {
+        const Cursor top = heap.top();
+        heap.pop();
+        advance(top.run);
+        if (hasCurrent && current.sameAs(top.item))
+        {
+            BookBuilder::mergeInto(current, top.item);
+            continue;
+        }
+        if (hasCurrent)
+        {
+            emit(current);
+        }
+        current = top.item;
+        hasCurrent = true;
+    }
+    if (hasCurrent)
+    {
+        emit(current);
+    }
+
+    files.clear();
+    for (const std::string& run : this->runs)
+    {
+        std::remove(run.c_str());
+    }
+    this->runs.clear();
+
+    header.count = count;
+    out.seekp(0, std::ios::beg);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::cout << "entries " << count << std::endl;
+    return bool(out);
+}
+
+int main(int argc, char* argv[])
+{
+    int maxPlies = 40;
+    int minGames = 1;
+    int memMb = 256;
+    std::vector<std::string> paths{};
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if ((arg == "-plies" || arg == "-min" || arg == "-mem") && i + 1 < argc)
+        {
+            const int value = std::max(std::atoi(argv[++i]), 1);
+            (arg == "-plies" ? maxPlies : arg == "-min" ? minGames : memMb) = value;
+        }
+        else
+        {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.size() < 2)
+    {
+        std::cout << "usage: Chess98Book [-plies N] [-min N] [-mem MB] <output> <input>..." << std::endl;
+        return 2;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    BookBuilder builder{paths[0], maxPlies, minGames, memMb};
+    bool ok = true;
+    for (size_t i = 1; i < paths.size(); i++)
+    {
+        ok = builder.readFile(paths[i]) && ok;
+    }
+    ok = builder.finish(paths[0]) && ok;
+    const int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "games " << builder.games << " skipped " << builder.skipped << " positions " << builder.positions << " time " << ms
+              << " positions/min " << builder.positions * 60000 / uint64(std::max<int64_t>(ms, 1)) << std::endl;
+    return ok ? 0 : 1;
+}
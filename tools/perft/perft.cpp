@@ -0,0 +1,43 @@
+﻿#include "perft.hpp"
+
+// 着法生成器的独立测试程序
+// 无参数: 运行内置的 perft 测试集, 失败时返回非零
+// perft <depth> [fen]: 统计指定局面的叶子节点数
+// divide <depth> [fen]: 按根节点着法分别统计
+int main(int argc, char* argv[])
+{
+    const std::string startFen = "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1";
+    if (argc < 2 || std::string(argv[1]) == "suite")
+    {
+        const int maxDepth = argc >= 3 ? std::atoi(argv[2]) : 4;
+        return Perft::suite(maxDepth) ? 0 : 1;
+    }
+
+    const std::string mode = argv[1];
+    if ((mode != "perft" && mode != "divide") || argc < 3)
+    {
+        std::cout << "usage: Chess98Perft [suite [maxdepth]] | perft <depth> [fen] | divide <depth> [fen]" << std::endl;
+        return 2;
+    }
+    const int depth = std::max(std::atoi(argv[2]), 1);
+    std::string fen = "";
+    for (int i = 3; i < argc; i++)
+    {
+        fen += (fen.empty() ? "" : " ") + std::string(argv[i]);
+    }
+    if (fen.empty())
+    {
+        fen = startFen;
+    }
+
+    Board board{fenToPieceidmap(fen), fenToTeam(fen)};
+    if (mode == "divide")
+    {
+        Perft::divide(board, depth);
+    }
+    else
+    {
+        Perft::run(board, depth);
+    }
+    return 0;
+}
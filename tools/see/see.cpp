@@ -0,0 +1,44 @@
+﻿#include "heuristic.hpp"
+
+// 吃子分类的回归测试
+// 检查静态交换评估的结果, 以及静止搜索的着法生成器是否剔除亏本的吃子
+struct SeeCase
+{
+    std::string fen;
+    Move move;
+    bool losing;
+    std::string name;
+};
+
+int main()
+{
+    const std::vector<SeeCase> cases = {
+        {"4k4/9/9/9/9/9/9/9/3pp4/3A1K3 w - - 0 1", Move{3, 0, 4, 1}, true, "guard takes defended pawn"},
+        {"4k4/9/4p4/4n4/9/9/4P4/4C4/9/3K5 w - - 0 1", Move{4, 2, 4, 6}, true, "cannon takes defended knight"},
+        {"4k4/9/9/4n4/9/9/4P4/4C4/9/3K5 w - - 0 1", Move{4, 2, 4, 6}, false, "cannon takes undefended knight"},
+    };
+
+    bool passed = true;
+    for (const SeeCase& c : cases)
+    {
+        Board board{fenToPieceidmap(c.fen), fenToTeam(c.fen)};
+        const int see = board.see(c.move);
+
+        // 静止搜索只生成吃子, 亏本的吃子不会给出
+        HistoryTable history{};
+        KillerTable killer{};
+        MovePicker picker(board, history, killer, Move{}, false, true);
+        bool picked = false;
+        for (Move move = picker.next(); move.id() != -1; move = picker.next())
+        {
+            picked = picked || move == c.move;
+        }
+
+        const bool ok = (see < 0) == c.losing && picked != c.losing;
+        passed = passed && ok;
+        std::cout << (ok ? "ok   " : "FAIL ") << c.name << " " << moveToUcci(c.move) << " see " << see << " picked " << picked
+                  << std::endl;
+    }
+    std::cout << "see test " << (passed ? "passed" : "failed") << std::endl;
+    return passed ? 0 : 1;
+}
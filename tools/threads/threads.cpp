@@ -0,0 +1,40 @@
+﻿#include "search.hpp"
+
+// 多线程搜索的回归测试
+// 在两次搜索之间改变线程数, 检查辅助线程池重建后每次搜索都能正常结束并给出合法着法
+// 超时未结束视为死锁, 返回非零
+int main(int argc, char* argv[])
+{
+    const int depth = argc >= 2 ? std::max(std::atoi(argv[1]), 1) : 6;
+    const std::vector<int> threadCounts = {4, 2, 3, 1, 4, 2};
+    const std::string fen = "1rbakabr1/9/n5n1c/p1p1p3p/6p2/9/P1cRP1P1P/1CN1B1NC1/5R3/3AKAB2 w - - 0 1";
+
+    std::promise<bool> done;
+    std::future<bool> result = done.get_future();
+    std::thread worker([&]() {
+        Search search{fenToPieceidmap(fen), fenToTeam(fen)};
+        search.useBook = false;
+        bool passed = true;
+        for (int threads : threadCounts)
+        {
+            search.threads = threads;
+            const Result best = search.searchMain(depth, TimeLimits{});
+            MoveList legalMoves;
+            MovesGen::getMoves(search.board, legalMoves);
+            const bool legal = std::find(legalMoves.begin(), legalMoves.end(), best.move) != legalMoves.end();
+            passed = passed && legal;
+            std::cout << (legal ? "ok   " : "FAIL ") << "threads " << threads << " bestmove " << moveToUcci(best.move) << std::endl;
+        }
+        done.set_value(passed);
+    });
+
+    if (result.wait_for(std::chrono::seconds(120)) != std::future_status::ready)
+    {
+        std::cout << "FAIL search did not finish" << std::endl;
+        std::_Exit(1);
+    }
+    worker.join();
+    const bool passed = result.get();
+    std::cout << "thread test " << (passed ? "passed" : "failed") << std::endl;
+    return passed ? 0 : 1;
+}